@@ -0,0 +1,129 @@
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <stdlib.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bpf_replay.h"
+#include "harness.h"
+
+// Per-report cost of the translation core over replayed traces
+// Usage: bench [-b] [-n reports] <trace>...
+// -b replays them through the HID-BPF program instead (bpf/tartarus.bpf.c), compiled from the same profiles
+// Branch and cache misses come from perf_event_open() and print as n/a where the counters are unavailable
+
+#define COUNTERS	2
+
+static const char* counter_name [COUNTERS] = { "branch-misses", "cache-misses" };
+static const u64 counter_config [COUNTERS] = { PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_HW_CACHE_MISSES };
+
+// Open one hardware counter of this thread (userspace only: the translation runs in this process)
+// Returns -1 if unavailable (no PMU, virtual machine, perf_event_paranoid)
+static int open_counter (u64 config) {
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = config;
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static u64 now_ns (void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// The HID-BPF program rewrites the report in place, so it gets a copy (as hid-core hands it its own buffer)
+// Returns 1 for a changed report, so events/report is the share of reports it rewrote
+static int replay_bpf (struct drvdata* data, u8* report) {
+	u8 buf [KEYLIST_LEN];
+
+	memcpy(buf, report, KEYLIST_LEN);
+	bpf_replay(buf);
+	return memcmp(buf, report, KEYLIST_LEN) != 0;
+}
+
+static int run_trace (struct trace* trace, long reports, int bpf) {
+	int (*replay) (struct drvdata*, u8*) = bpf ? replay_bpf : replay_report;
+	struct drvdata data;
+	int fd [COUNTERS];
+	u64 count [COUNTERS];
+	u64 events = 0;
+	u64 start;
+	u64 elapsed;
+	long done;
+	int status;
+	int i;
+
+	if ((status = init_device(&data))) return status;
+	if (bpf) load_bpf(&data);
+
+	for (i = 0; i < COUNTERS; ++i) {
+		fd[i] = open_counter(counter_config[i]);
+		if (fd[i] >= 0) ioctl(fd[i], PERF_EVENT_IOC_ENABLE, 0);
+	}
+
+	// Whole passes only, so every run of a trace ends with every key released
+	start = now_ns();
+	for (done = 0; done < reports; done += trace->len)
+		for (i = 0; i < trace->len; ++i) events += replay(&data, trace->report[i]);
+	elapsed = now_ns() - start;
+
+	printf("%-12s %-6s %9ld reports %8.1f ns/report %6.2f events/report", trace->name, bpf ? "bpf" : "module", done, (double) elapsed / done, (double) events / done);
+	for (i = 0; i < COUNTERS; ++i) {
+		if (fd[i] >= 0 && read(fd[i], count + i, sizeof(u64)) == sizeof(u64))
+			printf("  %s %.3f/report", counter_name[i], (double) count[i] / done);
+		else printf("  %s n/a", counter_name[i]);
+
+		if (fd[i] >= 0) close(fd[i]);
+	}
+	printf("\n");
+
+	free_device(&data);
+	return 0;
+}
+
+int main (int argc, char** argv) {
+	struct trace trace;
+	long reports = 2000000;
+	int bpf = 0;
+	int status = 0;
+	int opt;
+	int i;
+
+	while ((opt = getopt(argc, argv, "bn:")) != -1) {
+		switch (opt) {
+		case 'b':
+			bpf = 1;
+			break;
+		case 'n':
+			reports = strtol(optarg, NULL, 0);
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-b] [-n reports] <trace>...\n", argv[0]);
+			return 2;
+		}
+	}
+
+	for (i = optind; i < argc; ++i) {
+		if ((status = load_trace(argv[i], &trace))) {
+			fprintf(stderr, "%s: Unable to load trace (%s)\n", argv[i], strerror(-status));
+			return 1;
+		}
+
+		if (trace.len) status = run_trace(&trace, reports, bpf);
+		free_trace(&trace);
+		if (status) return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,43 @@
+#include <string.h>
+
+// Built against the stand-ins in bpfshim/ rather than vmlinux.h and the udev-hid-bpf helpers:
+// the maps are plain arrays here and the program edits the report in place, as it does in the kernel
+#include "../bpf/tartarus.bpf.c"
+#include "bpf_replay.h"
+
+static struct bpf_profile keymaps [BPF_PROFILES];
+static struct bpf_state bpf_state;
+static __u8* bpf_report;
+
+__u8* hid_bpf_get_data (struct hid_bpf_ctx* ctx, unsigned int offset, const size_t size) {
+	return bpf_report;
+}
+
+void* bpf_map_lookup_elem (void* map, const void* key) {
+	__u32 idx = *(const __u32*) key;
+
+	if (map == &tartarus_state) return idx ? NULL : &bpf_state;
+	return (idx < BPF_PROFILES) ? keymaps + idx : NULL;
+}
+
+// Fill profile n (1 - BPF_PROFILES) like `linapse.py -B` does ; returns nonzero if it does not exist
+int bpf_load_profile (int profile, const uint8_t* table) {
+	if (profile < 1 || profile > BPF_PROFILES) return -1;
+
+	memcpy(keymaps + profile - 1, table, sizeof(struct bpf_profile));
+	return 0;
+}
+
+void bpf_reset (void) {
+	memset(&bpf_state, 0, sizeof(bpf_state));
+	bpf_state.profile = 1;
+}
+
+// Run the program on one report (rewritten in place) ; returns the active profile afterwards
+int bpf_replay (uint8_t* report) {
+	struct hid_bpf_ctx ctx = { .size = REPORT_LEN };
+
+	bpf_report = report;
+	tartarus_event(&ctx);
+	return bpf_state.profile;
+}
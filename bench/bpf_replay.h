@@ -0,0 +1,14 @@
+#ifndef BENCH_BPF_REPLAY_H
+#define BENCH_BPF_REPLAY_H
+
+// The HID-BPF program (bpf/tartarus.bpf.c) built as plain C, to replay the same reports through it
+
+#include <stdint.h>
+
+#define BPF_TABLE_LEN	512			// struct bpf_profile: HID usage of every raw key, then its profile jump
+
+int bpf_load_profile (int, const uint8_t*);
+void bpf_reset (void);
+int bpf_replay (uint8_t*);
+
+#endif
@@ -0,0 +1,2 @@
+// Userspace stand-in for libbpf's BPF_PROG() (see bpf_replay.c)
+#define BPF_PROG(name, ...)		name (__VA_ARGS__)
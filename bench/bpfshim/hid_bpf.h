@@ -0,0 +1,10 @@
+// Userspace stand-ins for the udev-hid-bpf macros (see bpf_replay.c)
+#define SEC(name)				__attribute__((section(name), used))
+#define __uint(name, val)		int (*name) [val]
+#define __type(name, val)		typeof(val)* name
+#ifndef __always_inline
+#define __always_inline			inline __attribute__((always_inline))
+#endif
+#define HID_BPF_DEVICE_EVENT	"struct_ops/hid_device_event"
+#define HID_BPF_OPS(name)		SEC(".struct_ops.link") struct hid_bpf_ops name
+#define HID_BPF_CONFIG(...)
@@ -0,0 +1,6 @@
+// Userspace stand-ins for the HID-BPF helpers (defined by bpf_replay.c)
+#define BUS_USB					3
+#define HID_GROUP_GENERIC		1
+
+__u8* hid_bpf_get_data (struct hid_bpf_ctx*, unsigned int, const size_t);
+void* bpf_map_lookup_elem (void*, const void*);
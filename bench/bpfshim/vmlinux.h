@@ -0,0 +1,35 @@
+// Userspace stand-ins for the kernel types bpf/tartarus.bpf.c uses (see bpf_replay.c)
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint8_t __u8;
+typedef uint32_t __u32;
+typedef int32_t __s32;
+typedef uint64_t __u64;
+
+struct hid_device;
+
+struct hid_bpf_ctx {
+	struct hid_device* hid;
+	__u32 allocated_size;
+	union {
+		__s32 retval;
+		__s32 size;
+	};
+};
+
+struct hid_bpf_probe_args {
+	unsigned int hid;
+	unsigned int rdesc_size;
+	unsigned char rdesc [4096];
+	int retval;
+};
+
+struct hid_bpf_ops {
+	int (*hid_device_event) (struct hid_bpf_ctx*, int, __u64);
+};
+
+enum {
+	BPF_MAP_TYPE_ARRAY = 2,
+	LIBBPF_PIN_BY_NAME = 1,
+};
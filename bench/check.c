@@ -0,0 +1,263 @@
+#include <stdlib.h>
+
+#include "bpf_replay.h"
+#include "harness.h"
+
+// Checks of the translation core (make check)
+// Every check is a function in the table at the bottom ; a failed CHECK() reports and carries on with the next one
+
+static int failed;
+
+#define CHECK(cond, ...) do { \
+	if (!(cond)) { \
+		++failed; \
+		printf("FAIL %s:%d: ", __func__, __LINE__); \
+		printf(__VA_ARGS__); \
+		printf("\n"); \
+	} \
+} while (0)
+
+
+// -- MACROS --
+// check_macros() must reject any macro reaching past the code, however its offset and size wrap around
+static void check_macro_bounds (void) {
+	struct macros* macros = calloc(1, sizeof(struct macros));
+	const u8 tap [] = { MOP_DOWN, KEY_A, MOP_UP, KEY_A, MOP_END };
+
+	memcpy(macros->code, tap, sizeof(tap));
+	macros->len = sizeof(tap);
+	macros->size[1] = sizeof(tap);
+	CHECK(!check_macros(macros), "valid macro rejected");
+
+	// (offset + size wraps a u16 to 0: end - 1 would index code[-1])
+	macros->offset[1] = 0xFFFF;
+	macros->size[1] = 1;
+	CHECK(check_macros(macros), "offset 0xFFFF size 1 accepted");
+
+	macros->offset[1] = 0xFFFB;
+	macros->size[1] = 0x0009;
+	CHECK(check_macros(macros), "offset 0xFFFB size 9 (wraps to 4) accepted");
+
+	macros->offset[1] = 1;
+	macros->size[1] = sizeof(tap);
+	CHECK(check_macros(macros), "macro past the end of the code accepted");
+
+	macros->offset[1] = 0;
+	macros->size[1] = sizeof(tap) - 1;
+	CHECK(check_macros(macros), "macro without MOP_END accepted");
+
+	macros->size[1] = sizeof(tap);
+	macros->code[1] = MOP_KEY_MAX + 1;
+	CHECK(check_macros(macros), "key above MOP_KEY_MAX accepted");
+
+	free(macros);
+}
+
+
+// -- HID-BPF BACKEND --
+// The HID-BPF program must follow profile keys like the module, held keys and all
+static void check_bpf_profiles (void) {
+	struct drvdata data;
+	struct trace trace;
+	u8 buf [KEYLIST_LEN];
+	int profile;
+	int i;
+
+	if (load_trace("traces/swaps.trace", &trace)) {
+		CHECK(0, "traces/swaps.trace missing");
+		return;
+	}
+
+	init_device(&data);
+	load_bpf(&data);
+
+	for (i = 0; i < trace.len; ++i) {
+		memcpy(buf, trace.report[i], KEYLIST_LEN);
+		profile = bpf_replay(buf);
+		replay_report(&data, trace.report[i]);
+
+		if (profile == data.profile) continue;
+		CHECK(0, "report %d: module in profile %d, HID-BPF in profile %d", i, data.profile, profile);
+		break;
+	}
+
+	free_device(&data);
+	free_trace(&trace);
+}
+
+// Plain key binds must come out the same through either backend (keycodes stand in for usages, see load_bpf())
+static void check_bpf_keys (void) {
+	struct drvdata data;
+	struct trace trace;
+	u8 buf [KEYLIST_LEN];
+	u8 down [sizeof(sink.down)];
+	int i, k;
+
+	if (load_trace("traces/rolling6.trace", &trace)) {
+		CHECK(0, "traces/rolling6.trace missing");
+		return;
+	}
+
+	init_device(&data);
+	load_bpf(&data);
+
+	for (i = 0; i < trace.len; ++i) {
+		memcpy(buf, trace.report[i], KEYLIST_LEN);
+		bpf_replay(buf);
+		replay_report(&data, trace.report[i]);
+
+		memset(down, 0, sizeof(down));
+		for (k = 2; k < KEYLIST_LEN && buf[k]; ++k) down[buf[k] / 8] |= 1 << (buf[k] % 8);
+
+		if (!memcmp(down, sink.down, sizeof(down))) continue;
+		CHECK(0, "report %d: the backends hold different keys", i);
+		break;
+	}
+
+	free_device(&data);
+	free_trace(&trace);
+}
+
+
+// -- REPORT DECODING --
+// The report scan process_event_kbd() used before it diffed key bitmaps, kept as the reference for the decoder
+// It assumed the pad lists keys in press order and changes one thing per report
+static int scan_event_kbd (struct event* evlist, u8* keylist, u8* raw_event) {
+	u8 key;
+	u8 comp;
+	int idx;
+	int off = 0;
+	int count = 0;
+
+	if ((key = raw_event[0] ^ keylist[0])) {
+		keylist[0] = raw_event[0];
+		if (key & MODKEY_SHIFT) evlist[count++] = (struct event) { MODKEY_MASK | MODKEY_SHIFT, !!(raw_event[0] & MODKEY_SHIFT) };
+		if (key & MODKEY_ALT) evlist[count++] = (struct event) { MODKEY_MASK | MODKEY_ALT, !!(raw_event[0] & MODKEY_ALT) };
+		return count;
+	}
+
+	for (idx = 2; idx < KEYLIST_LEN; ++idx) {
+		key = raw_event[idx];
+		comp = (idx + off >= KEYLIST_LEN) ? 0x00 : keylist[idx + off];
+
+		if (!key && !comp) break;
+		if (key == comp) continue;
+
+		if (comp) {
+			evlist[count++] = (struct event) { comp, 0 };
+			++off;
+			--idx;
+			continue;
+		}
+
+		evlist[count++] = (struct event) { key, 1 };
+	}
+
+	memcpy(keylist, raw_event, KEYLIST_LEN);
+	return count;
+}
+
+// Keys a report holds (modifier bits at MODKEY_MASK | bit, as in struct keystate)
+static void report_keys (const u8* report, struct keystate* keys) {
+	int i;
+
+	memset(keys, 0, sizeof(*keys));
+	if (report[0] & MODKEY_SHIFT) keys->bytes[(MODKEY_MASK | MODKEY_SHIFT) / 8] |= 1 << ((MODKEY_MASK | MODKEY_SHIFT) % 8);
+	if (report[0] & MODKEY_ALT) keys->bytes[(MODKEY_MASK | MODKEY_ALT) / 8] |= 1 << ((MODKEY_MASK | MODKEY_ALT) % 8);
+	for (i = 2; i < KEYLIST_LEN && report[i]; ++i) keys->bytes[report[i] / 8] |= 1 << (report[i] % 8);
+}
+
+// Apply a list of key events to a key set
+// Returns nonzero if any event was not a change (a press of a held key, ...) or a key changed twice (a held key bounced)
+static int apply_events (struct keystate* keys, const struct event* evlist, int len) {
+	struct keystate seen = { 0 };
+	int bad = 0;
+	int i;
+
+	for (i = 0; i < len; ++i) {
+		bad |= !!(keys->bytes[evlist[i].idx / 8] & 1 << (evlist[i].idx % 8)) == evlist[i].state;
+		bad |= !!(seen.bytes[evlist[i].idx / 8] & 1 << (evlist[i].idx % 8));
+		keys->bytes[evlist[i].idx / 8] ^= 1 << (evlist[i].idx % 8);
+		seen.bytes[evlist[i].idx / 8] |= 1 << (evlist[i].idx % 8);
+	}
+
+	return bad;
+}
+
+// Replay a trace through both decoders, tracking the keys each believes are held against what the reports say
+// Returns the number of reports the old scan got wrong ; every report the decoder gets wrong fails the check
+static int diff_decoders (const char* path) {
+	struct trace trace;
+	struct keystate held = { 0 };
+	struct keystate truth;
+	struct keystate old = { 0 };
+	struct keystate new = { 0 };
+	struct event evlist [EVENT_MAX];
+	u8 keylist [KEYLIST_LEN] = { 0 };
+	int wrong = 0;
+	int len;
+	int bad;
+	int i;
+
+	if (load_trace(path, &trace)) {
+		CHECK(0, "%s missing", path);
+		return -1;
+	}
+
+	for (i = 0; i < trace.len; ++i) {
+		report_keys(trace.report[i], &truth);
+
+		len = process_event_kbd(evlist, &held, trace.report[i], KEYLIST_LEN);
+		bad = apply_events(&new, evlist, len);
+		CHECK(!bad && !memcmp(&new, &truth, sizeof(truth)), "%s report %d: the decoder lost track of the held keys", path, i);
+		if (bad || memcmp(&new, &truth, sizeof(truth))) break;
+
+		len = scan_event_kbd(evlist, keylist, trace.report[i]);
+		bad = apply_events(&old, evlist, len);
+		if (bad || memcmp(&old, &truth, sizeof(truth))) {
+			++wrong;
+			old = truth;
+		}
+	}
+
+	free_trace(&trace);
+	return wrong;
+}
+
+// Reports in press order, one change each: the decoder must agree with the old scan
+static void check_decode_ordered (void) {
+	const char* traces [] = { "traces/rolling6.trace", "traces/hypershift.trace", "traces/swaps.trace" };
+	int wrong;
+	int i;
+
+	for (i = 0; i < 3; ++i) {
+		wrong = diff_decoders(traces[i]);
+		CHECK(!wrong, "%s: the old scan disagrees on %d reports", traces[i], wrong);
+	}
+}
+
+// Keys out of press order: the decoder must still follow them (the old scan cannot)
+static void check_decode_shuffled (void) {
+	int wrong = diff_decoders("traces/shuffled.trace");
+
+	CHECK(wrong > 0, "traces/shuffled.trace: the old scan got every report right, so the trace tests nothing");
+	printf("shuffled: old scan wrong on %d reports, bitmap decoder on none\n", wrong);
+}
+
+
+static void (* const checks []) (void) = {
+	check_macro_bounds,
+	check_bpf_profiles,
+	check_bpf_keys,
+	check_decode_ordered,
+	check_decode_shuffled,
+};
+
+int main (void) {
+	unsigned int i;
+
+	for (i = 0; i < sizeof(checks) / sizeof(*checks); ++i) checks[i]();
+
+	printf("%u checks, %d failures\n", i, failed);
+	return failed ? 1 : 0;
+}
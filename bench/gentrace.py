@@ -0,0 +1,81 @@
+#!/usr/bin/env python3
+# Generates the replay traces in traces/ (raw keyboard reports of the pad, one per line)
+# The traces are synthesized rather than captured, but follow what the pad sends:
+# keys are listed in the order they were pressed and every report changes at most a couple of keys
+# Seeded, so rerunning this reproduces the committed files exactly
+
+import random
+
+TYPING = [0x2B, 0x14, 0x1A, 0x08, 0x15, 0x39, 0x04, 0x16, 0x07, 0x09, 0x1D, 0x1B, 0x06, 0x2C]
+PROFILE = [0x1E, 0x1F, 0x20, 0x21, 0x22]
+THUMB = [0x50, 0x52, 0x4F, 0x51]
+SHIFT = 0x02			# Key 16
+ALT = 0x04				# Circle (hypershift in the bench profiles)
+REPORTS = 4096
+
+def report(mods, keys):
+	keys = (keys + [0] * 6)[:6]
+	return " ".join("%02x" % b for b in [mods, 0] + keys)
+
+# Rolling presses with up to six keys down (fast typing) ; the oldest key comes up once six are held
+def rolling(rng):
+	out = []
+	held = []
+	while len(out) < REPORTS - 1:
+		if len(held) == 6 or (held and rng.random() < 0.3):
+			held.pop(0)
+		else:
+			held.append(rng.choice([k for k in TYPING + THUMB if k not in held]))
+		out.append(report(0, held))
+	return out + [report(0, [])]
+
+# Hypershift held and released every report or two while keys are typed through it
+def hypershift(rng):
+	out = []
+	held = []
+	mods = 0
+	while len(out) < REPORTS - 2:
+		roll = rng.random()
+		if roll < 0.4: mods ^= ALT
+		elif roll < 0.5: mods ^= SHIFT
+		elif len(held) == 3 or (held and roll < 0.75): held.pop(rng.randrange(len(held)))
+		else: held.append(rng.choice([k for k in TYPING if k not in held]))
+		out.append(report(mods, held))
+	return out + [report(0, held), report(0, [])]
+
+# Profile keys tapped while typing keys are held (every tap swaps the profile under the held keys)
+def swaps(rng):
+	out = []
+	held = []
+	while len(out) < REPORTS - 2:
+		if len(held) == 3 or (held and rng.random() < 0.3): held.pop(0)
+		elif rng.random() < 0.5: held.append(rng.choice([k for k in TYPING if k not in held]))
+		out.append(report(0, held))
+
+		tap = rng.choice(PROFILE)
+		out.append(report(0, held + [tap]))
+		out.append(report(0, held))
+	return out[:REPORTS - 1] + [report(0, [])]
+
+# The rolling presses with every report listing its keys in a random order
+# The pad keeps them in press order, but nothing guarantees it (the old report scan misread such reports)
+def shuffled(rng):
+	out = []
+	for line in rolling(random.Random("rolling6")):
+		keys = [k for k in bytes.fromhex(line)[2:] if k]
+		rng.shuffle(keys)
+		out.append(report(0, keys))
+	return out
+
+TRACES = {
+	"rolling6": rolling,
+	"hypershift": hypershift,
+	"swaps": swaps,
+	"shuffled": shuffled,
+}
+
+if __name__ == "__main__":
+	for name, gen in TRACES.items():
+		with open(f"traces/{name}.trace", "w") as file:
+			file.write(f"# {name} (bench/gentrace.py)\n")
+			file.write("\n".join(gen(random.Random(name))) + "\n")
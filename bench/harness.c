@@ -0,0 +1,136 @@
+#include <errno.h>
+#include <stdlib.h>
+
+#include "bpf_replay.h"
+#include "harness.h"
+#include "keymap.h"
+
+struct sink sink;
+
+static void sink_event (u64 event) {
+	sink.hash = (sink.hash ^ event) * 0x100000001B3ULL;
+}
+
+// -- SINKS (see translate.h) --
+void report_key (struct drvdata* data, unsigned int code, int state) {
+	++sink.keys;
+	sink_event(((u64) code << 8) | state);
+	if (state) sink.down[code / 8] |= 1 << (code % 8);
+	else sink.down[code / 8] &= ~(1 << (code % 8));
+	if (sink.log) fprintf(sink.log, "key 0x%03x %d\n", code, state);
+}
+
+void report_rel (struct drvdata* data, unsigned int code, int value) {
+	++sink.rels;
+	sink_event(((u64) code << 32) | (u32) value);
+	if (sink.log) fprintf(sink.log, "rel 0x%02x %d\n", code, value);
+}
+
+void set_profile (struct drvdata* data, u8 profile) {
+	++sink.swaps;
+	sink_event(0x10000 | profile);
+	if (sink.log) fprintf(sink.log, "profile %d\n", profile);
+
+	data->profile = profile;
+}
+
+// The bench device has no macros
+int play_macro (struct drvdata* data, u8 macro, u8 state) {
+	return 1;
+}
+
+
+// -- DEVICE --
+// Profiles of the bench device, built from the driver defaults (keymap.h) so every trace runs against one setup:
+// Profile n is the debug keymap (profile keys 01 - 05) with its key binds shifted by n - 1, so every swap rewrites the
+// held keys, and the circle holds profile n + 1 as a hypershift layer (wrapping around)
+// NOTE: Mirrors device_probe() and build_maps() (driver.c) minus the allocations the kernel makes
+int init_device (struct drvdata* data) {
+	struct profile profiles [BENCH_PROFILES];
+	struct kbddata* kdata = calloc(1, sizeof(struct kbddata));
+	struct kbdmaps* maps;
+	int len = 0;
+	int i, k;
+
+	for (i = 0; i < BENCH_PROFILES; ++i) {
+		memcpy(profiles[i].keymap, debug_keymap, sizeof(struct profile));
+		for (k = 0; k < KEYMAP_LEN; ++k)
+			if (profiles[i].keymap[k].type == CTRL_KEY) profiles[i].keymap[k].data += i;
+
+		profiles[i].keymap[RZKEY_CIRCLE] = (struct bind) { CTRL_SHIFT, 0, (i + 1) % BENCH_PROFILES + 1 };
+		len += pack_profile_kbd(NULL, profiles + i, NULL);
+	}
+
+	maps = calloc(1, sizeof(struct kbdmaps) + (BENCH_PROFILES + 1) * sizeof(u16) + len * sizeof(struct sparsebind));
+	if (!kdata || !maps) {
+		free(kdata);
+		free(maps);
+		return -ENOMEM;
+	}
+
+	maps->count = BENCH_PROFILES;
+	maps->len = len;
+	maps->binds = (struct sparsebind*) (maps->offset + BENCH_PROFILES + 1);
+	for (i = 0, len = 0; i < BENCH_PROFILES; ++i) {
+		len += pack_profile_kbd(NULL, profiles + i, maps->binds + len);
+		maps->offset[i + 1] = len;
+	}
+
+	memset(data, 0, sizeof(struct drvdata));
+	memset(&sink, 0, sizeof(sink));
+	kdata->maps = maps;
+	data->idata = kdata;
+	data->inum = 0;
+
+	select_profile_kbd(data, 1);
+	return 0;
+}
+
+void free_device (struct drvdata* data) {
+	struct kbddata* kdata = data->idata;
+
+	free(kdata->maps);
+	free(kdata->macros);
+	free(kdata);
+	data->idata = NULL;
+}
+
+// Translate one report like handle_event() ; returns the number of key events it decoded
+int replay_report (struct drvdata* data, u8* report) {
+	struct kbddata* kdata = data->idata;
+	struct event evlist [EVENT_MAX];
+	int len;
+	int i;
+
+	if (!data->profile) return 0;
+
+	len = process_event_kbd(evlist, &kdata->held, report, KEYLIST_LEN);
+	for (i = 0; i < len; ++i) resolve_event_kbd(evlist + i, data);
+
+	return len;
+}
+
+// Compile the profiles of the bench device for the HID-BPF program, like compile_bpf() in linapse.py
+// Keycodes stand in for their HID usages (the program only copies them) ; hypershift binds are dropped as there
+void load_bpf (struct drvdata* data) {
+	struct kbddata* kdata = data->idata;
+	struct profile profile;
+	u8 table [BPF_TABLE_LEN];
+	struct bind* bind;
+	int p, key;
+
+	for (p = 1; p <= kdata->maps->count; ++p) {
+		memset(table, 0, sizeof(table));
+		expand_profile_kbd(kdata->maps, p, &profile);
+
+		for (key = 0; key < KEYMAP_LEN; ++key) {
+			bind = profile.keymap + key;
+			if (bind->type == CTRL_KEY && !bind->mods && bind->data <= 0xFF) table[key] = bind->data;
+			else if (bind->type == CTRL_PROFILE) table[KEYMAP_LEN + key] = bind->data;
+		}
+
+		bpf_load_profile(p, table);
+	}
+
+	bpf_reset();
+}
@@ -0,0 +1,29 @@
+#ifndef BENCH_HARNESS_H
+#define BENCH_HARNESS_H
+
+// Userspace build of the input translation core (translate.c) for benchmarks and tests
+// Reports are replayed the way handle_event() feeds them, into sinks that record what would reach the input device
+
+#include "translate.h"
+#include "tracefile.h"
+
+#define BENCH_PROFILES	5			// Profiles of the bench device (see init_device())
+
+// Output of the translation (report_key(), report_rel(), set_profile())
+struct sink {
+	u64 keys;						// Key events
+	u64 rels;						// Relative axis events
+	u64 swaps;						// Profile changes
+	u64 hash;						// Every event in order (runs with the same output hash the same)
+	u8 down [(KEY_MAX + 1) / 8];	// Keys currently down (bit n -> keycode n)
+	FILE* log;						// Events as text ; NULL -> Count only
+};
+
+extern struct sink sink;
+
+int init_device (struct drvdata*);
+void free_device (struct drvdata*);
+int replay_report (struct drvdata*, u8*);
+void load_bpf (struct drvdata*);
+
+#endif
@@ -0,0 +1,263 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <linux/input.h>
+#include <linux/uinput.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "translate.h"
+#include "uhid.h"
+
+// First keystroke latency and inter-key jitter of a macro played by the driver, against the same macro played by a
+// userspace daemon (the route of macros the driver does not hold: KEY_MACRO1 from the pad -> uinput)
+// Usage: macro_latency [-u] [-n runs] [-k keys] [-d delay_ms]
+// Key 01 of a virtual pad is bound to macro 1, which taps KEY_A <keys> times, <delay> ms apart ; -u plays it from here
+// Latency runs from the report pressing key 01 to the first KEY_A press read back from evdev, and jitter is how far
+// every later press lands from <delay> after the one before (both as seen by a reader) ; needs root and the module loaded
+
+#define MACRO_INDEX		1			// KEY_MACRO1 when the driver does not hold the macro
+
+static int keys = 8;
+static int delay_ms = 10;
+static int uinput = -1;				// Userspace route (-u) ; -1 -> Driver plays the macro
+static int pad_events = -1;
+
+static int open_events (const char* pattern) {
+	char path [300];
+	glob_t found;
+	int fd = -1;
+	int clock = CLOCK_MONOTONIC;
+
+	if (glob(pattern, 0, NULL, &found) || !found.gl_pathc) return -ENODEV;
+	snprintf(path, sizeof(path), "/dev/input/%s", strrchr(found.gl_pathv[0], '/') + 1);
+	globfree(&found);
+
+	if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0) return -errno;
+	ioctl(fd, EVIOCSCLOCKID, &clock);
+	return fd;
+}
+
+static void emit (int fd, int type, int code, int value) {
+	struct input_event ev = { .type = type, .code = code, .value = value };
+
+	if (write(fd, &ev, sizeof(ev)) != sizeof(ev)) perror("uinput");
+}
+
+// The userspace macro daemon: plays the macro whenever KEY_MACRO1 goes down, pacing it on absolute deadlines
+// like the sequencer in the driver
+static void* daemon_thread (void* arg) {
+	struct input_event ev;
+	struct timespec due;
+	int i;
+
+	while (read(pad_events, &ev, sizeof(ev)) == sizeof(ev)) {
+		if (ev.type != EV_KEY || ev.code != KEY_MACRO1 || ev.value != 1) continue;
+
+		clock_gettime(CLOCK_MONOTONIC, &due);
+		for (i = 0; i < keys; ++i) {
+			emit(uinput, EV_KEY, KEY_A, 1);
+			emit(uinput, EV_SYN, SYN_REPORT, 0);
+			emit(uinput, EV_KEY, KEY_A, 0);
+			emit(uinput, EV_SYN, SYN_REPORT, 0);
+
+			due.tv_nsec += delay_ms * 1000000L;
+			due.tv_sec += due.tv_nsec / 1000000000;
+			due.tv_nsec %= 1000000000;
+			if (i + 1 < keys) clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL);
+		}
+	}
+
+	return NULL;
+}
+
+static int open_uinput (void) {
+	struct uinput_setup setup;
+	char name [64];
+	char pattern [128];
+	int fd;
+
+	if ((fd = open("/dev/uinput", O_WRONLY | O_CLOEXEC)) < 0) return -errno;
+
+	memset(&setup, 0, sizeof(setup));
+	setup.id.bustype = BUS_VIRTUAL;
+	snprintf(setup.name, sizeof(setup.name), "macro_latency daemon");
+
+	ioctl(fd, UI_SET_EVBIT, EV_KEY);
+	ioctl(fd, UI_SET_KEYBIT, KEY_A);
+	if (ioctl(fd, UI_DEV_SETUP, &setup) || ioctl(fd, UI_DEV_CREATE) || ioctl(fd, UI_GET_SYSNAME(sizeof(name)), name) < 0) {
+		close(fd);
+		return -errno;
+	}
+
+	uinput = fd;
+	snprintf(pattern, sizeof(pattern), "/sys/devices/virtual/input/%s/event*", name);
+	for (int tries = 0; tries < 50; ++tries, usleep(20000))
+		if ((fd = open_events(pattern)) >= 0) return fd;
+
+	return fd;
+}
+
+// Macro 1 taps KEY_A (see struct macrocfg in module.h) ; the userspace route uploads no macros at all
+static size_t build_macros (u8* buf, int userspace) {
+	u16 header [2 + MACRO_COUNT] = { 0 };
+	u8* code = buf + sizeof(header);
+	u16 len = 0;
+	int i;
+
+	for (i = 0; i < keys && !userspace; ++i) {
+		code[len++] = MOP_DOWN;
+		code[len++] = KEY_A;
+		code[len++] = MOP_UP;
+		code[len++] = KEY_A;
+		if (i + 1 == keys) break;
+
+		code[len++] = MOP_DELAY;
+		code[len++] = delay_ms & 0xFF;
+		code[len++] = delay_ms >> 8;
+	}
+	if (!userspace) code[len++] = MOP_END;
+
+	((u8*) header)[0] = 1;			// MCR_VERSION_MAJOR
+	header[1] = len;
+	header[2 + MACRO_INDEX] = len;
+	memcpy(buf, header, sizeof(header));
+
+	return sizeof(header) + len;
+}
+
+static int compare_u64 (const void* a, const void* b) {
+	return (*(const u64*) a > *(const u64*) b) - (*(const u64*) a < *(const u64*) b);
+}
+
+int main (int argc, char** argv) {
+	static u8 macros [4096];
+	struct profile profile;
+	struct input_event ev;
+	struct pollfd pfd;
+	char pattern [600];
+	pthread_t daemon;
+	u8 press [8] = { 0, 0, RZKEY_01 };
+	u8 release [8] = { 0 };
+	u64* first;
+	u64 start;
+	u64 now;
+	u64 prev = 0;
+	u64 gap;
+	u64 jitter_sum = 0;
+	u64 jitter_max = 0;
+	long gaps = 0;
+	int runs = 100;
+	int userspace = 0;
+	int measure;
+	int got;
+	int fd;
+	int opt;
+	int i;
+
+	while ((opt = getopt(argc, argv, "un:k:d:")) != -1) {
+		switch (opt) {
+		case 'u': userspace = 1; break;
+		case 'n': runs = atoi(optarg); break;
+		case 'k': keys = atoi(optarg); break;
+		case 'd': delay_ms = atoi(optarg); break;
+		default:
+			fprintf(stderr, "Usage: %s [-u] [-n runs] [-k keys] [-d delay_ms]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	// (The macro has to fit in MACRO_CODE_LEN, at 7 bytes per key)
+	if (runs <= 0 || keys <= 0 || keys > 500 || delay_ms < 0 || delay_ms > 0xFFFF) {
+		fprintf(stderr, "At least one run, 1 - 500 keys, and a delay of 0 - 65535 ms\n");
+		return 2;
+	}
+
+	if ((fd = open("/dev/uhid", O_RDWR | O_CLOEXEC)) < 0) {
+		perror("/dev/uhid");
+		return 1;
+	}
+
+	if (open_pad(fd, "macro_latency")) {
+		fprintf(stderr, "Unable to bind a virtual pad to hid-tartarus\n");
+		close_pad(fd);
+		return 1;
+	}
+
+	// Bind key 01 of the active profile to the macro (the pad goes away with this process)
+	if (read_attr("profile", (char*) &profile, sizeof(profile)) != sizeof(profile)) {
+		fprintf(stderr, "Unable to read the active profile\n");
+		close_pad(fd);
+		return 1;
+	}
+
+	profile.keymap[RZKEY_01] = (struct bind) { CTRL_MACRO, 0, MACRO_INDEX };
+	if (write_attr("profile", (char*) &profile, sizeof(profile)) || write_attr("macros", (char*) macros, build_macros(macros, userspace))) {
+		fprintf(stderr, "Unable to upload the macro\n");
+		close_pad(fd);
+		return 1;
+	}
+
+	snprintf(pattern, sizeof(pattern), "%s/input/input*/event*", sysfs_dir);
+	pad_events = open_events(pattern);
+	measure = userspace ? open_uinput() : pad_events;
+	if (pad_events < 0 || measure < 0) {
+		fprintf(stderr, "Unable to open the event devices (%s)\n", strerror(-((pad_events < 0) ? pad_events : measure)));
+		close_pad(fd);
+		return 1;
+	}
+
+	if (userspace) pthread_create(&daemon, NULL, daemon_thread, NULL);
+	usleep(100000);
+
+	first = calloc(runs, sizeof(u64));
+	pfd = (struct pollfd) { .fd = measure, .events = POLLIN };
+
+	for (i = 0; i < runs; ++i) {
+		start = now_ns();
+		send_report(fd, press);
+
+		for (got = 0; got < keys && poll(&pfd, 1, 1000 + keys * delay_ms) > 0; ) {
+			if (read(measure, &ev, sizeof(ev)) != sizeof(ev)) break;
+			if (ev.type != EV_KEY || ev.code != KEY_A || ev.value != 1) continue;
+
+			now = now_ns();
+			if (!got) first[i] = now - start;
+			else {
+				gap = now - prev;
+				gap = (gap > delay_ms * 1000000ULL) ? gap - delay_ms * 1000000ULL : delay_ms * 1000000ULL - gap;
+				jitter_sum += gap;
+				if (gap > jitter_max) jitter_max = gap;
+				++gaps;
+			}
+
+			prev = now;
+			++got;
+		}
+
+		send_report(fd, release);
+		if (got < keys) {
+			fprintf(stderr, "Run %d: only %d of %d keys arrived\n", i, got, keys);
+			runs = i;
+			break;
+		}
+
+		usleep(20000);
+	}
+
+	if (runs) {
+		qsort(first, runs, sizeof(u64), compare_u64);
+		printf("%s: %d runs of %d keys %d ms apart  first key p50 %.1f  p99 %.1f  max %.1f us  inter-key jitter mean %.1f  max %.1f us\n",
+				userspace ? "userspace daemon" : "driver", runs, keys, delay_ms, first[runs / 2] / 1e3, first[runs * 99 / 100] / 1e3,
+				first[runs - 1] / 1e3, gaps ? (double) jitter_sum / gaps / 1e3 : 0.0, jitter_max / 1e3);
+	}
+
+	free(first);
+	close_pad(fd);
+	return runs ? 0 : 1;
+}
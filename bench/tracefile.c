@@ -0,0 +1,48 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tracefile.h"
+
+// One report per line as hex bytes ; '#' starts a comment
+int load_trace (const char* path, struct trace* trace) {
+	char line [256];
+	const char* name;
+	unsigned int b [TRACE_REPORT_LEN];
+	int cap = 0;
+	int i;
+	FILE* file = fopen(path, "r");
+
+	if (!file) return -errno;
+
+	name = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+	snprintf(trace->name, sizeof(trace->name), "%.*s", (int) strcspn(name, "."), name);
+	trace->len = 0;
+	trace->report = NULL;
+
+	while (fgets(line, sizeof(line), file)) {
+		if (line[0] == '#' || line[0] == '\n') continue;
+		if (sscanf(line, "%x %x %x %x %x %x %x %x", b, b + 1, b + 2, b + 3, b + 4, b + 5, b + 6, b + 7) != TRACE_REPORT_LEN) {
+			fprintf(stderr, "%s: Malformed report '%s'\n", path, line);
+			fclose(file);
+			free(trace->report);
+			return -EINVAL;
+		}
+
+		if (trace->len == cap) {
+			cap = cap ? cap * 2 : 1024;
+			trace->report = realloc(trace->report, cap * sizeof(*trace->report));
+		}
+
+		for (i = 0; i < TRACE_REPORT_LEN; ++i) trace->report[trace->len][i] = b[i];
+		++trace->len;
+	}
+
+	fclose(file);
+	return 0;
+}
+
+void free_trace (struct trace* trace) {
+	free(trace->report);
+	trace->report = NULL;
+}
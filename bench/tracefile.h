@@ -0,0 +1,21 @@
+#ifndef BENCH_TRACEFILE_H
+#define BENCH_TRACEFILE_H
+
+// Replay traces (traces/*.trace, see gentrace.py)
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define TRACE_REPORT_LEN	8		// Raw keyboard report of the pad (KEYLIST_LEN)
+
+// Raw keyboard reports, replayed in order
+struct trace {
+	char name [64];
+	int len;
+	uint8_t (*report) [TRACE_REPORT_LEN];
+};
+
+int load_trace (const char*, struct trace*);
+void free_trace (struct trace*);
+
+#endif
@@ -0,0 +1,148 @@
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "uhid.h"
+
+// Boot protocol keyboard, which is what the keyboard interface of the pad reports
+static const uint8_t rdesc [] = {
+	0x05, 0x01, 0x09, 0x06, 0xA1, 0x01, 0x05, 0x07, 0x19, 0xE0, 0x29, 0xE7, 0x15, 0x00, 0x25, 0x01,
+	0x75, 0x01, 0x95, 0x08, 0x81, 0x02, 0x95, 0x01, 0x75, 0x08, 0x81, 0x01, 0x95, 0x05, 0x75, 0x01,
+	0x05, 0x08, 0x19, 0x01, 0x29, 0x05, 0x91, 0x02, 0x95, 0x01, 0x75, 0x03, 0x91, 0x01, 0x95, 0x06,
+	0x75, 0x08, 0x15, 0x00, 0x25, 0x65, 0x05, 0x07, 0x19, 0x00, 0x29, 0x65, 0x81, 0x00, 0xC0,
+};
+
+char sysfs_dir [512];
+
+uint64_t now_ns (void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+int uhid_send (int fd, const struct uhid_event* ev) {
+	return (write(fd, ev, sizeof(*ev)) == sizeof(*ev)) ? 0 : -errno;
+}
+
+// Create the virtual pad and wait for hid-core to start it
+static int create_device (int fd, const char* name, const char* phys) {
+	struct uhid_event ev;
+	int status;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.type = UHID_CREATE2;
+	snprintf((char*) ev.u.create2.name, sizeof(ev.u.create2.name), "Razer Tartarus V2 (%s)", name);
+	snprintf((char*) ev.u.create2.phys, sizeof(ev.u.create2.phys), "%s", phys);
+	memcpy(ev.u.create2.rd_data, rdesc, sizeof(rdesc));
+	ev.u.create2.rd_size = sizeof(rdesc);
+	ev.u.create2.bus = BUS_USB;
+	ev.u.create2.vendor = 0x1532;
+	ev.u.create2.product = 0x022b;
+
+	if ((status = uhid_send(fd, &ev))) return status;
+
+	do {
+		if (read(fd, &ev, sizeof(ev)) <= 0) return -errno;
+	} while (ev.type != UHID_START);
+
+	return 0;
+}
+
+// Send one raw keyboard report (handle_event() is done with it once this returns)
+int send_report (int fd, const uint8_t* report) {
+	struct uhid_event ev;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.type = UHID_INPUT2;
+	ev.u.input2.size = 8;
+	memcpy(ev.u.input2.data, report, 8);
+
+	return uhid_send(fd, &ev);
+}
+
+// Find the sysfs directory hid-tartarus made for the device (matched by its phys)
+static int find_device (const char* phys) {
+	char path [768];
+	char line [256];
+	struct dirent* entry;
+	FILE* file;
+	DIR* dir;
+	int tries;
+
+	for (tries = 0; tries < 100; ++tries, usleep(20000)) {
+		if (!(dir = opendir(DRIVER_PATH))) continue;
+
+		while ((entry = readdir(dir))) {
+			snprintf(path, sizeof(path), DRIVER_PATH "/%s/uevent", entry->d_name);
+			if (!(file = fopen(path, "r"))) continue;
+
+			while (fgets(line, sizeof(line), file)) {
+				if (strncmp(line, "HID_PHYS=", 9) || strncmp(line + 9, phys, strlen(phys))) continue;
+
+				snprintf(sysfs_dir, sizeof(sysfs_dir), DRIVER_PATH "/%s", entry->d_name);
+				fclose(file);
+				closedir(dir);
+				return 0;
+			}
+			fclose(file);
+		}
+		closedir(dir);
+	}
+
+	return -ENODEV;
+}
+
+ssize_t read_attr (const char* name, char* buf, size_t len) {
+	char path [600];
+	ssize_t total = 0;
+	ssize_t ret;
+	int fd;
+
+	snprintf(path, sizeof(path), "%s/%s", sysfs_dir, name);
+	if ((fd = open(path, O_RDONLY)) < 0) return -errno;
+	while ((size_t) total < len && (ret = read(fd, buf + total, len - total)) > 0) total += ret;
+	close(fd);
+
+	return total;
+}
+
+// Bin attributes take the write in page sized chunks, in order
+int write_attr (const char* name, const char* buf, size_t len) {
+	char path [600];
+	size_t total = 0;
+	ssize_t ret;
+	int fd;
+
+	snprintf(path, sizeof(path), "%s/%s", sysfs_dir, name);
+	if ((fd = open(path, O_WRONLY)) < 0) return -errno;
+	while (total < len && (ret = write(fd, buf + total, len - total)) > 0) total += ret;
+	close(fd);
+
+	return (total == len) ? 0 : -EIO;
+}
+
+// Create a virtual keyboard interface and wait for hid-tartarus to bind it (fd: /dev/uhid)
+// The interface number comes from phys (see device_inum())
+int open_pad (int fd, const char* name) {
+	char phys [64];
+	int status;
+
+	snprintf(phys, sizeof(phys), "%s-%d/input0", name, getpid());
+	if ((status = create_device(fd, name, phys))) return status;
+	return find_device(phys);
+}
+
+// Remove the virtual pad (hid-tartarus caches its profiles like any unplugged pad) and close /dev/uhid
+void close_pad (int fd) {
+	struct uhid_event ev;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.type = UHID_DESTROY;
+	uhid_send(fd, &ev);
+	close(fd);
+}
@@ -0,0 +1,22 @@
+#ifndef BENCH_UHID_H
+#define BENCH_UHID_H
+
+// Virtual pads (/dev/uhid) bound by hid-tartarus (see Virtual Devices in the README)
+
+#include <linux/uhid.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define DRIVER_PATH		"/sys/bus/hid/drivers/hid-tartarus"
+
+extern char sysfs_dir [512];		// Device directory of the open pad
+
+uint64_t now_ns (void);
+int uhid_send (int, const struct uhid_event*);
+int send_report (int, const uint8_t*);
+int open_pad (int, const char*);
+void close_pad (int);
+ssize_t read_attr (const char*, char*, size_t);
+int write_attr (const char*, const char*, size_t);
+
+#endif
@@ -0,0 +1,158 @@
+#define _GNU_SOURCE			// RUSAGE_THREAD
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "tracefile.h"
+#include "uhid.h"
+
+// Replays traces into a virtual pad (/dev/uhid) bound by hid-tartarus and times every report
+// Usage: uhid_replay [-n reports] [-w writers] [-i interval_us] <trace>...
+// A UHID_INPUT2 write runs hid_input_report() (and so handle_event()) inside write(), so the time a write takes
+// bounds the time the report spent in the driver, and the system time of the thread is the kernel cost per report
+// Writer threads hammer profile_num, profile, and config (in turn) while the reports replay, to show contention
+// with the sysfs writers ; needs root and the module loaded
+
+static volatile int writers_stop;
+static unsigned long writes_done;
+
+static uint64_t thread_sys_ns (void) {
+	struct rusage usage;
+
+	getrusage(RUSAGE_THREAD, &usage);
+	return usage.ru_stime.tv_sec * 1000000000ULL + usage.ru_stime.tv_usec * 1000ULL;
+}
+
+// Writer n cycles profile_num (n % 3 == 0) or rewrites profile (1) or config (2) with what it read when it started
+static void* writer (void* arg) {
+	long kind = (long) arg % 3;
+	static const char* attr [3] = { "profile_num", "profile", "config" };
+	size_t cap = 1 << 20;
+	char* buf = malloc(cap);
+	ssize_t len;
+	int profile = 1;
+
+	if (!buf || (len = read_attr(attr[kind], buf, cap)) <= 0) {
+		fprintf(stderr, "Unable to read %s\n", attr[kind]);
+		free(buf);
+		return NULL;
+	}
+
+	while (!writers_stop) {
+		if (kind == 0) len = snprintf(buf, cap, "%d", profile++ % 5 + 1);
+		if (!write_attr(attr[kind], buf, len)) __atomic_add_fetch(&writes_done, 1, __ATOMIC_RELAXED);
+	}
+
+	free(buf);
+	return NULL;
+}
+
+static int compare_u32 (const void* a, const void* b) {
+	return (*(const uint32_t*) a > *(const uint32_t*) b) - (*(const uint32_t*) a < *(const uint32_t*) b);
+}
+
+static int replay (int fd, const struct trace* trace, long reports, int writers, long interval_us) {
+	pthread_t threads [64];
+	struct timespec next;
+	uint32_t* lat = malloc(reports * sizeof(uint32_t));
+	uint64_t sys;
+	uint64_t start;
+	long done;
+	int status = 0;
+	int i;
+
+	if (!lat) return -ENOMEM;
+
+	writers_stop = 0;
+	writes_done = 0;
+	for (i = 0; i < writers; ++i) pthread_create(threads + i, NULL, writer, (void*) (long) i);
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	sys = thread_sys_ns();
+
+	for (done = 0; done < reports && !status; ++done) {
+		// Pace the reports like the pad polls, if asked to
+		if (interval_us) {
+			next.tv_nsec += interval_us * 1000;
+			next.tv_sec += next.tv_nsec / 1000000000;
+			next.tv_nsec %= 1000000000;
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+		}
+
+		start = now_ns();
+		status = send_report(fd, trace->report[done % trace->len]);
+		lat[done] = now_ns() - start;
+	}
+
+	sys = thread_sys_ns() - sys;
+	writers_stop = 1;
+	for (i = 0; i < writers; ++i) pthread_join(threads[i], NULL);
+
+	if (status) fprintf(stderr, "UHID_INPUT2 failed (%s)\n", strerror(-status));
+	else if (done) {
+		qsort(lat, done, sizeof(uint32_t), compare_u32);
+		printf("%-12s %2d writers %8ld reports  write p50 %6.2f  p99 %6.2f  p99.9 %7.2f  max %8.2f us  sys %6.0f ns/report  (%lu sysfs writes)\n",
+				trace->name, writers, done, lat[done / 2] / 1e3, lat[done * 99 / 100] / 1e3, lat[done * 999 / 1000] / 1e3,
+				lat[done - 1] / 1e3, (double) sys / done, writes_done);
+	}
+
+	free(lat);
+	return status;
+}
+
+int main (int argc, char** argv) {
+	struct trace trace;
+	long reports = 100000;
+	long interval_us = 0;
+	int writers = 0;
+	int status = 0;
+	int opt;
+	int fd;
+	int i;
+
+	while ((opt = getopt(argc, argv, "n:w:i:")) != -1) {
+		switch (opt) {
+		case 'n': reports = strtol(optarg, NULL, 0); break;
+		case 'w': writers = atoi(optarg); break;
+		case 'i': interval_us = strtol(optarg, NULL, 0); break;
+		default:
+			fprintf(stderr, "Usage: %s [-n reports] [-w writers] [-i interval_us] <trace>...\n", argv[0]);
+			return 2;
+		}
+	}
+
+	if (writers < 0 || writers > 64 || reports <= 0) {
+		fprintf(stderr, "Between 0 and 64 writers, and at least one report\n");
+		return 2;
+	}
+
+	if ((fd = open("/dev/uhid", O_RDWR | O_CLOEXEC)) < 0) {
+		perror("/dev/uhid");
+		return 1;
+	}
+
+	if ((status = open_pad(fd, "uhid_replay"))) {
+		fprintf(stderr, "Unable to bind a virtual pad to hid-tartarus (%s)\n", strerror(-status));
+		close_pad(fd);
+		return 1;
+	}
+
+	for (i = optind; i < argc && !status; ++i) {
+		if ((status = load_trace(argv[i], &trace))) {
+			fprintf(stderr, "%s: Unable to load trace (%s)\n", argv[i], strerror(-status));
+			break;
+		}
+
+		if (trace.len) status = replay(fd, &trace, reports, writers, interval_us);
+		free_trace(&trace);
+	}
+
+	close_pad(fd);
+	return status ? 1 : 0;
+}
@@ -0,0 +1,163 @@
+// SPDX-License-Identifier: GPL-2.0
+// HID-BPF keymap backend for the Razer Tartarus v2
+// Rewrites keyboard reports before hid-core parses them, so plain remaps work without the kernel module (hid-generic)
+// Only CTRL_KEY and CTRL_PROFILE binds can be expressed here ; everything else (hypershift, macros) needs the module
+// NOTE: Use one or the other: with the module bound as well, its keymap would apply on top of this one
+
+// Requires linux >= 6.11 (HID-BPF struct_ops) and the helpers from udev-hid-bpf (https://gitlab.freedesktop.org/libevdev/udev-hid-bpf)
+// Build (vmlinux.h from `bpftool btf dump file /sys/kernel/btf/vmlinux format c`):
+//   clang -O2 -g -target bpf -I<udev-hid-bpf>/src/bpf -I. -c tartarus.bpf.c -o tartarus.bpf.o
+// udev-hid-bpf attaches it to the keyboard interface of every Tartarus (see HID_BPF_CONFIG and probe())
+// The tables are filled through the pinned maps by `linapse.py -B` (see compile_bpf())
+
+#include "vmlinux.h"
+#include "hid_bpf.h"
+#include "hid_bpf_helpers.h"
+#include <bpf/bpf_tracing.h>
+
+#define VENDOR_ID		0x1532		// Razer USA, Ltd
+#define PRODUCT_ID		0x022b		// Tartarus_V2
+
+#define BPF_PROFILES	8			// Profiles the keymaps map holds (fixed, unlike the module's ; see BPF_PROFILES_ in linapse.py)
+#define REPORT_LEN		8			// Boot keyboard report: modifiers, reserved, 6 keys
+#define KEYLIST_LEN		8			// Raw keys held at once (6 normal keys + shift and alt)
+
+#define MODKEY_SHIFT	0x02		// Modifier bits of the raw report (see translate.h)
+#define MODKEY_ALT		0x04
+#define MODKEY_MASK		0x40
+
+HID_BPF_CONFIG(
+	HID_DEVICE(BUS_USB, HID_GROUP_GENERIC, VENDOR_ID, PRODUCT_ID)
+);
+
+// One compiled profile (indexed by raw key, as in struct profile)
+struct bpf_profile {
+	__u8 usage [256];		// HID usage to report ; 0 -> Drop ; 0xE0 - 0xE7 -> Modifier
+	__u8 jump [256];		// Profile number to change to upon press ; 0 -> None
+};
+
+// Remapping state
+// NOTE: Shared by every attached device (there is normally only one Tartarus)
+struct bpf_state {
+	__u8 profile;					// Active profile number (1 - BPF_PROFILES)
+	__u8 held [KEYLIST_LEN];		// Raw keys of the previous report (to detect presses)
+	__u8 ignore [32];				// Keys dropped until they are released (profile keys)
+};
+
+struct {
+	__uint(type, BPF_MAP_TYPE_ARRAY);
+	__uint(max_entries, BPF_PROFILES);
+	__type(key, __u32);
+	__type(value, struct bpf_profile);
+	__uint(pinning, LIBBPF_PIN_BY_NAME);
+} tartarus_keymaps SEC(".maps");
+
+struct {
+	__uint(type, BPF_MAP_TYPE_ARRAY);
+	__uint(max_entries, 1);
+	__type(key, __u32);
+	__type(value, struct bpf_state);
+	__uint(pinning, LIBBPF_PIN_BY_NAME);
+} tartarus_state SEC(".maps");
+
+// Raw keys of a report (modifier bits become MODKEY_MASK indices, as in the module)
+static __always_inline int held_keys (const __u8* report, __u8* keys) {
+	int count = 0;
+	int i;
+
+	if (report[0] & MODKEY_SHIFT) keys[count++] = MODKEY_MASK | MODKEY_SHIFT;
+	if (report[0] & MODKEY_ALT) keys[count++] = MODKEY_MASK | MODKEY_ALT;
+
+	for (i = 2; i < REPORT_LEN && count < KEYLIST_LEN; ++i) {
+		if (!report[i]) break;
+		keys[count++] = report[i];
+	}
+
+	return count;
+}
+
+static __always_inline struct bpf_profile* lookup_profile (__u8 profile) {
+	__u32 idx = profile - 1;
+
+	if (!profile || profile > BPF_PROFILES) return NULL;
+	return bpf_map_lookup_elem(&tartarus_keymaps, &idx);
+}
+
+SEC(HID_BPF_DEVICE_EVENT)
+int BPF_PROG(tartarus_event, struct hid_bpf_ctx* hctx) {
+	__u8* report = hid_bpf_get_data(hctx, 0, REPORT_LEN);
+	struct bpf_profile* map;
+	struct bpf_state* state;
+	__u8 keys [KEYLIST_LEN] = { 0 };
+	__u8 ignore [32] = { 0 };
+	__u8 out [REPORT_LEN] = { 0 };
+	__u32 zero = 0;
+	__u8 usage;
+	__u8 key;
+	int count;
+	int len = 2;
+	int i, j;
+
+	if (!report || hctx->size < REPORT_LEN) return 0;
+
+	state = bpf_map_lookup_elem(&tartarus_state, &zero);
+	if (!state) return 0;
+	if (!state->profile) state->profile = 1;
+
+	count = held_keys(report, keys);
+
+	// Profile keys act upon press (keys missing from the previous report)
+	// Held keys simply report their mapping in the new profile, which amounts to the module's key -> key swap
+	for (i = 0; i < KEYLIST_LEN && i < count; ++i) {
+		key = keys[i];
+		for (j = 0; j < KEYLIST_LEN && state->held[j] != key; ++j);
+		if (j < KEYLIST_LEN) continue;
+
+		map = lookup_profile(state->profile);
+		if (!map || !map->jump[key] || map->jump[key] > BPF_PROFILES) continue;
+
+		state->profile = map->jump[key];
+		state->ignore[key / 8] |= 1 << (key % 8);
+	}
+
+	// Keep ignoring only the keys which are still held
+	for (i = 0; i < KEYLIST_LEN && i < count; ++i) {
+		key = keys[i];
+		ignore[key / 8] |= state->ignore[key / 8] & 1 << (key % 8);
+	}
+
+	__builtin_memcpy(state->ignore, ignore, sizeof(ignore));
+	__builtin_memcpy(state->held, keys, sizeof(keys));
+
+	// Rebuild the report from the active profile
+	map = lookup_profile(state->profile);
+	if (!map) return 0;
+
+	for (i = 0; i < KEYLIST_LEN && i < count; ++i) {
+		key = keys[i];
+		if (ignore[key / 8] & 1 << (key % 8)) continue;
+
+		usage = map->usage[key];
+		if (!usage) continue;
+
+		if (usage >= 0xE0 && usage <= 0xE7) out[0] |= 1 << (usage - 0xE0);
+		else if (len < REPORT_LEN) out[len++] = usage;
+	}
+
+	__builtin_memcpy(report, out, REPORT_LEN);
+	return 0;
+}
+
+HID_BPF_OPS(tartarus) = {
+	.hid_device_event = (void*) tartarus_event,
+};
+
+// Only attach to the keyboard interface (report descriptor starts with Usage Page: Generic Desktop, Usage: Keyboard)
+SEC("syscall")
+int probe (struct hid_bpf_probe_args* ctx) {
+	ctx->retval = ctx->rdesc_size > 3 && ctx->rdesc[0] == 0x05 && ctx->rdesc[1] == 0x01
+		&& ctx->rdesc[2] == 0x09 && ctx->rdesc[3] == 0x06 ? 0 : -22;		// -EINVAL
+	return 0;
+}
+
+char _license[] SEC("license") = "GPL";
@@ -0,0 +1,2333 @@
+#include "module.h"			// Module and device defines
+#include "keymap.h"			// HARD-CODED DEFAULT PROFILE
+
+#define CREATE_TRACE_POINTS
+#include "trace.h"			// Tracepoints (report -> bind -> input pipeline)
+
+// -- MODULE --
+static int __init module_load (void) {
+	int status;
+
+	// NOTE: debugfs failures are not fatal (later calls accept the error pointer)
+	debug_root = debugfs_create_dir("tartarus", NULL);
+	if ((status = hid_register_driver(&hid_tartarus))) {
+		// A pad may have bound and been removed again before the registration failed (caching its profiles)
+		debugfs_remove_recursive(debug_root);
+		cache_clear();
+	}
+
+	return status;
+}
+
+static void __exit module_unload (void) {
+	hid_unregister_driver(&hid_tartarus);
+	debugfs_remove_recursive(debug_root);
+	cache_clear();
+}
+
+
+// -- DEVICE EVENTS --
+// Find the interface number of a HID device
+// Real devices report it through the USB interface descriptor
+// Virtual (UHID) devices have no USB parent, so they must follow the usbhid convention of ending phys with "/input<inum>"
+static int device_inum (struct hid_device* dev, u8* inum) {
+	struct usb_interface* intf;
+	const char* suffix;
+
+	if (hid_is_usb(dev)) {
+		intf = to_usb_interface(dev->dev.parent);
+		*inum = intf->cur_altsetting->desc.bInterfaceNumber;
+		return 0;
+	}
+
+	suffix = strrchr(dev->phys, '/');
+	if (!suffix || strncmp(suffix, "/input", 6) || kstrtou8(suffix + 6, 10, inum)) {
+		printk(KERN_WARNING "HID Tartarus: Unable to determine interface number from phys '%s'\n", dev->phys);
+		return -ENODEV;
+	}
+
+	return 0;
+}
+
+// Nominal polling interval of the interface's interrupt IN endpoint (microseconds)
+// Full and low speed intervals count 1 ms frames ; high speed ones are 2^(bInterval - 1) microframes of 125 us
+// Returns 0 if unknown (virtual devices have no endpoint)
+static u32 device_interval (struct hid_device* dev) {
+	struct usb_interface* intf;
+	struct usb_host_interface* alt;
+	struct usb_endpoint_descriptor* ep;
+	int i;
+
+	if (!hid_is_usb(dev)) return 0;
+
+	intf = to_usb_interface(dev->dev.parent);
+	alt = intf->cur_altsetting;
+
+	for (i = 0; i < alt->desc.bNumEndpoints; ++i) {
+		ep = &alt->endpoint[i].desc;
+		if (!usb_endpoint_is_int_in(ep)) continue;
+
+		if (interface_to_usbdev(intf)->speed >= USB_SPEED_HIGH) return 125 << (clamp_val(ep->bInterval, 1, 16) - 1);
+		return ep->bInterval * 1000;
+	}
+
+	return 0;
+}
+
+// Probe called upon device detection (initalization step)
+static int device_probe (struct hid_device* dev, const struct hid_device_id* id) {
+	int status;
+	unsigned long flags;
+
+	struct usb_device* parent = NULL;
+	u8 inum;
+
+	struct drvdata* data = NULL;
+	struct kbddata* kdata = NULL;
+	// struct mousedata* mdata = NULL;
+	struct kbdmaps* maps = NULL;
+	struct macros* macros = NULL;
+	struct profile* defaults = NULL;
+	void* idata = NULL;
+	u8 profile = 1;
+	u8 restored = 0;
+
+	// struct razer_report cmd;		// (debugging)
+	// struct razer_report out;		// (debugging)
+	// printk(KERN_INFO "Attempting to initalize Tartarus HID driver (0x%02x)\n", inum);	// (debugging)
+
+	// Only the control channel cares about the transport
+	if ((status = device_inum(dev, &inum))) return status;
+	if (hid_is_usb(dev)) parent = interface_to_usbdev(to_usb_interface(dev->dev.parent));
+
+	// Initalize driver data
+	switch (inum) {
+	case EXT_INUM:
+		// TODO: Not sure what this interface is used for
+		//     ^^Just save the inum and exit
+		data = kzalloc(sizeof(struct drvdata), GFP_KERNEL);
+		if ((status = data ? 0 : -ENOMEM)) goto probe_fail;
+		
+		data->inum = inum;
+		hid_set_drvdata(dev, data);
+		
+		return 0;
+		/*/
+		break;
+		//*/
+		
+	case KBD_INUM:
+		// Keyboard
+		idata = kzalloc(sizeof(struct kbddata), GFP_KERNEL);
+		if ((status = idata ? 0 : -ENOMEM)) goto probe_fail;
+
+		// Come back with the profiles the pad had before it went away (replug, re-enumeration)
+		// Otherwise start from the profile pack, and failing that, the hard-coded defaults
+		restored = !cache_restore(dev, &maps, &macros, &profile);
+		if (!restored && load_pack(dev, &maps, &macros)) {
+			// Manually set keymap (debugging)
+			defaults = kmalloc_array(3, sizeof(struct profile), GFP_KERNEL);
+			if ((status = defaults ? 0 : -ENOMEM)) goto probe_fail;
+
+			memcpy(defaults[0].keymap, debug_keymap, sizeof(struct profile));
+			memcpy(defaults[1].keymap, base_keymap, sizeof(struct profile));
+			memcpy(defaults[2].keymap, shift_keymap, sizeof(struct profile));
+
+			maps = build_maps(NULL, 0, PROFILE_COUNT, NULL, defaults, 1, 3);
+			kfree(defaults);
+			if ((status = maps ? 0 : -ENOMEM)) goto probe_fail;
+			//*/
+		}
+
+		kdata = idata;
+		RCU_INIT_POINTER(kdata->maps, maps);
+		RCU_INIT_POINTER(kdata->macros, macros);
+		
+		// Create device files
+		if((status = device_create_file(&dev->dev, &dev_attr_profile_count))) goto probe_fail;
+		if((status = device_create_file(&dev->dev, &dev_attr_profile_num))) goto probe_fail;
+		if((status = device_create_file(&dev->dev, &dev_attr_profile))) goto probe_fail;
+		if((status = device_create_file(&dev->dev, &dev_attr_led_stats))) goto probe_fail;
+		if((status = device_create_bin_file(&dev->dev, &bin_attr_config))) goto probe_fail;
+		if((status = device_create_bin_file(&dev->dev, &bin_attr_macros))) goto probe_fail;
+		if((status = device_create_bin_file(&dev->dev, &bin_attr_state))) goto probe_fail;
+
+		break;
+		
+	case MOUSE_INUM:
+		// "Mouse"
+		idata = kzalloc(sizeof(struct mousedata), GFP_KERNEL);
+		if ((status = idata ? 0 : -ENOMEM)) goto probe_fail;
+
+		// mdata = idata;
+		
+		// if(device_create_file(&dev->dev, &dev_attr_profile_num)) return -1;
+		// if(device_create_file(&dev->dev, &dev_attr_profile)) return -1;
+		break;
+	}
+
+	// Interface type device file
+	if((status = device_create_file(&dev->dev, &dev_attr_intf_type))) goto probe_fail;
+
+	data = kzalloc(sizeof(struct drvdata), GFP_KERNEL);
+	if ((status = data ? 0 : -ENOMEM)) goto probe_fail;
+
+	mutex_init(&data->lock);
+	spin_lock_init(&data->state_lock);
+	INIT_WORK(&data->notify_work, notify_work);
+	data->profile = profile ? profile : 1;
+	data->inum = inum;
+	data->idata = idata;
+	data->parent = parent;
+	data->dev = &dev->dev;
+	data->ctrl = parent ? &ctrl_usb : &ctrl_stub;
+
+	// Only the keyboard interface sends device commands (profile LEDs, queries)
+	if (inum == KBD_INUM && (status = init_command_queue(data))) goto probe_fail;
+	if (inum == KBD_INUM && (status = init_profile_led(data))) goto probe_fail;
+	if (inum == KBD_INUM && (status = init_macro(data))) goto probe_fail;
+
+	// The state page is mapped by userspace, so it gets a page of its own
+	if (inum == KBD_INUM) {
+		data->state = (struct statepage*) get_zeroed_page(GFP_KERNEL);
+		if ((status = data->state ? 0 : -ENOMEM)) goto probe_fail;
+		data->state->version = STATE_VERSION;
+	}
+
+	data->lat = alloc_percpu(struct latency);
+	if ((status = data->lat ? 0 : -ENOMEM)) goto probe_fail;
+
+	data->jitter = kzalloc(sizeof(struct jitter), GFP_KERNEL);
+	if ((status = data->jitter ? 0 : -ENOMEM)) goto probe_fail;
+	data->jitter->interval_us = device_interval(dev);
+
+	debugfs_init(dev, data);
+	
+	hid_set_drvdata(dev, data);
+
+	// Begin device communication
+	// NOTE: Device must be fully prepared before hid_hw_start() (including dev_drvdata)
+	if ((status = hid_parse(dev))) goto probe_fail;
+	if ((status = hid_hw_start(dev, HID_CONNECT_DEFAULT))) goto probe_fail;
+
+	// Ensure the device starts with the right profile LED
+	if (inum == KBD_INUM) {
+		spin_lock_irqsave(&data->state_lock, flags);
+		rcu_read_lock();
+		select_profile_kbd(data, data->profile);
+		rcu_read_unlock();
+		spin_unlock_irqrestore(&data->state_lock, flags);
+
+		/*/ Send a dummy device command (debugging)
+		cmd = init_report(CMD_KBD_LAYOUT);
+		if (!send_command(data, &cmd, &out)) log_report(&out);
+		//*/
+	}
+
+#ifdef CONFIG_PM
+	// Let the idle pad sleep (usbhid arms remote wakeup once the input is opened, so a keypress wakes it up)
+	// The keyboard interface speaks for the whole pad, since only the device as a whole is suspended
+	if (parent && inum == KBD_INUM && autosuspend) {
+		// The delay stays whatever usbcore or udev set, unless autosuspend_delay was given
+		if (autosuspend_delay >= 0) {
+			data->prev_delay = parent->dev.power.autosuspend_delay;
+			data->delay_set = 1;
+			pm_runtime_set_autosuspend_delay(&parent->dev, autosuspend_delay);
+		}
+
+		if (!parent->dev.power.runtime_auto) {
+			usb_enable_autosuspend(parent);
+			data->autosuspend = 1;
+		}
+	}
+#endif
+
+	// Log success to kernel
+	printk(KERN_INFO "HID Tartarus: Successfully bound device driver  Vendor ID: 0x%02x  Product ID: 0x%02x  Interface Num: 0x%02x  Control: %s\n", id->vendor, id->product, inum, data->ctrl->name);
+	// printk(KERN_INFO "HID Device Info:  devnum: %d  devpath: %s\n", usb->devnum, usb->devpath);	// (debugging)
+
+	return 0;
+
+probe_fail:
+	// Profiles taken from the cache go back to it rather than being lost with the failed probe
+	if (!restored || cache_insert(dev, maps, macros, profile)) {
+		if (maps) kvfree(maps);
+		if (macros) kfree(macros);
+	}
+	if (idata) kfree(idata);
+	if (data) {
+		debugfs_remove_recursive(data->debug_dir);
+		free_percpu(data->lat);
+		kfree(data->jitter);
+		free_macro(data);
+		free_command_queue(data);
+		free_profile_led(data);
+		free_page((unsigned long) data->state);
+		kfree(data);
+	}
+	printk(KERN_WARNING "HID Tartarus: Failed to initalize driver (status: 0x%02x)\n", inum);
+	return status;
+}
+
+// Define device input parameters (input_dev event types, available keys, etc.)
+// NOTE: Called by kernel during hid_hw_start() (insde device probe)
+static int input_config (struct hid_device* dev, struct hid_input* input) {
+	struct input_dev* input_dev = input->input;
+	struct drvdata* dev_data = hid_get_drvdata(dev);
+	if (!dev_data) return -1;	// TODO: We might want to use a different errno
+
+	// Save our input device for later use (can be cast but this is easier)
+	// Thanks: https://github.com/nirenjan/libx52/blob/482c5980abd865106a418853783692346e19ebb6/kernel_module/hid-saitek-x52.c#L124
+	dev_data->input = input_dev;
+
+	// Specify our input conditions
+	switch (dev_data->inum) {
+	case EXT_INUM:		// Should never run but this is nondestructive if so
+	case KBD_INUM:
+		// Keyboard (https://elixir.bootlin.com/linux/v6.7/source/drivers/input/input.c#L432)
+		// KEYCODES: https://elixir.bootlin.com/linux/v6.7/source/include/uapi/linux/input-event-codes.h#L65
+		set_bit(EV_KEY, input_dev->evbit);
+
+		// Every key a bind may send (regular keys, and the extended ones up to KEY_MAX)
+		// This includes the macro keys (0x290 - 0x2AD, 0x2B0 - 0x2B5) which undefined CTRL_MACRO binds fall back to
+		for (int i = 1; i <= KEY_MAX; ++i) if (bindable_key(i)) set_bit(i, input_dev->keybit);
+
+		// The input core buffers a frame until input_sync(), but flushes it early (with a SYN_REPORT of its own) once
+		// the buffer sized for a plain keyboard is full, which would split a profile swap across frames
+		input_set_events_per_packet(input_dev, FRAME_EVENTS);
+
+		// (DEBUG)
+		// printk(KERN_INFO "Device pointers : Input -> %p , Device %p , Parent %p\n", &input->input->dev.parent, dev->dev.parent, dev->dev.parent->parent);
+		
+		break;
+	
+	case MOUSE_INUM:
+		// "Mouse"
+		set_bit(EV_REL, input_dev->evbit);
+		set_bit(REL_WHEEL, input_dev->relbit);
+
+		// For the middle button
+		// https://elixir.bootlin.com/linux/v6.7.5/source/drivers/hid/usbhid/usbmouse.c#L167
+		set_bit(EV_KEY, input_dev->evbit);
+		set_bit(BTN_MOUSE, input_dev->keybit);
+		set_bit(BTN_MIDDLE, input_dev->keybit);
+
+		break;
+	}
+	
+	return 0;
+}
+
+// Cleanup resources when device is disconnected
+static void device_disconnect (struct hid_device* dev) {
+	// Get the device data
+	struct drvdata* data = hid_get_drvdata(dev);
+	struct kbddata* kdata;
+	unsigned long flags;
+	void* idata;
+
+	// No device data, something probably went wrong
+	if (!data) return;
+
+	switch (data->inum) {
+	case EXT_INUM:
+		// Mysterious interface
+		kfree(data);
+		return;
+	case KBD_INUM:
+		// Keyboard
+
+		// Try to turn off the profile lights before disconnecting
+		// Stop any macro too: its timer must not outlive the input device
+		spin_lock_irqsave(&data->state_lock, flags);
+		set_profile(data, 0);
+		stop_macro(data);
+		if (data->input) input_sync(data->input);
+		publish_state(data, -1);
+		spin_unlock_irqrestore(&data->state_lock, flags);
+		
+		device_remove_file(&dev->dev, &dev_attr_profile_count);
+		device_remove_file(&dev->dev, &dev_attr_profile_num);
+		device_remove_file(&dev->dev, &dev_attr_profile);
+		device_remove_file(&dev->dev, &dev_attr_led_stats);
+		device_remove_bin_file(&dev->dev, &bin_attr_config);
+		device_remove_bin_file(&dev->dev, &bin_attr_macros);
+		device_remove_bin_file(&dev->dev, &bin_attr_state);		// Also revokes any userspace mappings
+
+		// Once no sysfs write can select a macro again (a report still may, which free_macro() guards against)
+		free_macro(data);
+		break;
+	case MOUSE_INUM:
+		// Mouse
+		// device_remove_file(&dev->dev, &dev_attr_profile);
+		break;
+	}
+
+	// Interface type device file
+	device_remove_file(&dev->dev, &dev_attr_intf_type);
+
+	// Stop the device 
+	hid_hw_stop(dev);
+
+	// Cleanup
+	// NOTE: The report path can no longer run once the device is stopped, so no grace period is needed
+	if (data->inum == KBD_INUM && (kdata = data->idata)) {
+		cache_store(dev, data);
+		kvfree(rcu_dereference_protected(kdata->maps, 1));
+		kfree(rcu_dereference_protected(kdata->macros, 1));
+		kvfree(kdata->config_buf);
+	}
+
+	// Lets the final (lights off) LED commands through before releasing the queue
+	free_command_queue(data);
+	free_profile_led(data);
+	cancel_work_sync(&data->notify_work);
+
+#ifdef CONFIG_PM
+	// Leave runtime power management as it was found (unless it was changed through sysfs since)
+	if (data->delay_set && data->parent->dev.power.autosuspend_delay == autosuspend_delay)
+		pm_runtime_set_autosuspend_delay(&data->parent->dev, data->prev_delay);
+	if (data->autosuspend && data->parent->dev.power.runtime_auto) usb_disable_autosuspend(data->parent);
+#endif
+
+	debugfs_remove_recursive(data->debug_dir);
+	free_percpu(data->lat);
+	kfree(data->jitter);
+	free_page((unsigned long) data->state);
+
+	if ((idata = data->idata)) kfree(idata);
+	kfree(data);
+
+	printk(KERN_INFO "HID Tartarus: Driver unbound\n");
+}
+
+#ifdef CONFIG_PM
+// Release whatever is held before the device goes to sleep
+// The device would not report the releases while suspended, and keys held across it would come back stuck
+// Autosuspend (the pad was idle) keeps the state as is instead: the pad wakes up upon the next keypress and reports it
+static int device_suspend (struct hid_device* dev, pm_message_t message) {
+	struct drvdata* data = hid_get_drvdata(dev);
+	unsigned long flags;
+
+	if (!data || data->inum == EXT_INUM) return 0;
+	if (PMSG_IS_AUTO(message)) return autosuspend_kbd(data);
+
+	spin_lock_irqsave(&data->state_lock, flags);
+	rcu_read_lock();
+
+	switch (data->inum) {
+	case KBD_INUM:
+		stop_macro(data);
+		release_keys_kbd(data);
+		publish_state(data, -1);
+		break;
+	case MOUSE_INUM:
+		report_key(data, BTN_MIDDLE, 0);
+		break;
+	}
+
+	if (data->input) input_sync(data->input);
+	data->resume_ns = 0;
+	data->autosuspended = 0;
+
+	rcu_read_unlock();
+	spin_unlock_irqrestore(&data->state_lock, flags);
+
+	// Let the LED commands already queued finish (no transfer should be in flight while the device sleeps)
+	drain_command_queue(data, 20);
+	return 0;
+}
+
+// Refuse to autosuspend while anything is held (like usbhid does for its own keys)
+// The state is kept, so this only guards against a pad which would not wake up to report the release
+// NOTE: The command queue holds the device awake on its own (see queue_command())
+static int autosuspend_kbd (struct drvdata* data) {
+	struct kbddata* kdata = data->idata;
+	unsigned long flags;
+	int status = 0;
+
+	if (data->inum != KBD_INUM) return 0;
+
+	spin_lock_irqsave(&data->state_lock, flags);
+
+	if (kdata->play.active || memchr_inv(&kdata->held, 0, sizeof(struct keystate))) status = -EBUSY;
+	else {
+		data->resume_ns = 0;
+		data->autosuspended = 1;
+	}
+
+	spin_unlock_irqrestore(&data->state_lock, flags);
+	return status;
+}
+
+static int device_resume (struct hid_device* dev) {
+	struct drvdata* data = hid_get_drvdata(dev);
+
+	if (!data || data->inum != KBD_INUM) return 0;
+	return resume_kbd(data, !data->autosuspended);
+}
+
+// The device was reset, which loses nothing the driver keeps (profiles live in the driver, not the pad)
+static int device_reset_resume (struct hid_device* dev) {
+	struct drvdata* data = hid_get_drvdata(dev);
+
+	if (!data || data->inum != KBD_INUM) return 0;
+	return resume_kbd(data, 1);
+}
+
+// Input resumes right away and nothing here waits on the device
+// After a system sleep (restore), the key state was cleared upon suspend and the pad has forgotten its LEDs,
+// so the LEDs of the active profile are sent again (in the background)
+// After an autosuspend, the state was kept and the pad stayed powered: the keypress which woke it is simply reported
+static int resume_kbd (struct drvdata* data, u8 restore) {
+	unsigned long flags;
+
+	spin_lock_irqsave(&data->state_lock, flags);
+	rcu_read_lock();
+
+	// (Nothing to release unless the suspend callback was skipped)
+	if (restore && release_keys_kbd(data)) {
+		if (data->input) input_sync(data->input);
+		publish_state(data, -1);
+	}
+	data->resume_ns = latency_start();
+
+	rcu_read_unlock();
+	spin_unlock_irqrestore(&data->state_lock, flags);
+
+	// Commands queued while the device was resuming need not wait out their retry delay
+	kick_command_queue(data);
+
+	if (restore && data->leds && data->profile) resync_profile_led(data);
+	return 0;
+}
+#endif
+
+// Called upon any keypress/release
+// NOTE: EV_KEY and available keys must be set in .input_configured
+static int handle_event (struct hid_device* dev, struct hid_report* report, u8* raw_event, int raw_event_len) {
+	/*/ Some notes for developement:
+
+		The device seems to keep track of the order that the keys are
+		pressed which seems to be reflected in the event
+
+		Because of this, the trivial solution would be to simply
+		iterate the new report and check it against our existing
+		keylist
+
+		If this is assumed and then the report is out of order,
+		all subsequent buttons would be registered as "unpressed"
+		However, we should expect at most one key change per report,
+		so we could either detect this or make it our stopping condition
+
+		Rather than rely on the ordering, each report is converted
+		into a bitmap of held keys and diffed against the previous
+		one (see process_event_kbd()), which costs the same for any
+		report and cannot misread a reordered one
+
+		TODO: Reference kernel implementation of event parsing
+		https://elixir.bootlin.com/linux/v6.0.11/source/drivers/hid/usbhid/usbkbd.c#L117
+	/*/
+
+	int i;
+	int len = 0;
+	unsigned long flags;
+	u64 start;
+	u64 stage;
+	struct event evlist[EVENT_MAX];
+	struct drvdata* data = hid_get_drvdata(dev);
+	struct kbddata* kdata;
+	struct mousedata* mdata;
+
+	if (!data) return -1;					// Device not initalized
+	start = latency_start();
+	trace_tartarus_report(data->inum, raw_event, raw_event_len);
+	if (!READ_ONCE(data->profile)) goto hidraw;			// Device is disabled
+
+	// We lock here because some keys change the device profile
+	// As a result, it would be possible to press a key and release a different key
+	// NOTE: raw_event may be called from interrupt context, so this must never sleep
+	//       Keymaps are read under RCU, so profile writers never hold this lock for long
+	spin_lock_irqsave(&data->state_lock, flags);
+	rcu_read_lock();
+	// log_event(event, size, (data) ? data->inum : 0xFF); 	// (DEBUG)
+
+	// Stamp the events of this report with its arrival rather than the time they are emitted (after the lock and resolve)
+	// NOTE: latency_start() reads the monotonic clock, like input timestamps
+	jitter_record(data->jitter, start);
+	if (data->input) input_set_timestamp(data->input, ns_to_ktime(start));
+
+	// Build a list of input actions from the event, updating the device state
+	switch (data->inum) {
+	case KBD_INUM:
+		if (!data->profile) break;		// Disabled while we waited for the lock
+		kdata = data->idata;
+		stage = latency_start();
+		len = process_event_kbd(evlist, &kdata->held, raw_event, raw_event_len);
+		latency_record(data, LAT_DECODE, stage);
+
+		stage = latency_start();
+		for (i = 0; i < len; ++i) {
+			trace_tartarus_event(data->inum, evlist + i);
+			resolve_event_kbd(evlist + i, data);
+		}
+		latency_record(data, LAT_RESOLVE, stage);
+		publish_state(data, len);
+
+		// First key event since the device resumed (with an autosuspend, usually the keypress which woke it up)
+		if (unlikely(data->resume_ns) && len) {
+			trace_tartarus_wake(data->autosuspended, data->resume_ns);
+			latency_record(data, LAT_RESUME, data->resume_ns);
+			data->resume_ns = 0;
+		}
+		break;
+
+	case MOUSE_INUM:
+		mdata = data->idata;
+		stage = latency_start();
+		len = process_event_mouse(evlist, raw_event, raw_event_len);
+		latency_record(data, LAT_DECODE, stage);
+
+		stage = latency_start();
+		for (i = 0; i < len; ++i) {
+			trace_tartarus_event(data->inum, evlist + i);
+			resolve_event_mouse(evlist + i, data);
+		}
+		latency_record(data, LAT_RESOLVE, stage);
+		break;
+	}
+
+	// hid-core stops here (no field walk, no hid-input pass), so the input frame is closed by the driver
+	if (data->input) input_sync(data->input);
+	latency_record(data, LAT_REPORT, start);
+
+	rcu_read_unlock();
+	spin_unlock_irqrestore(&data->state_lock, flags);
+
+hidraw:
+	// Nor does hid-core copy a consumed report to hidraw, so its readers get the report (as the pad sent it) from here
+	if (dev->claimed & HID_CLAIMED_HIDRAW) hidraw_report_event(dev, raw_event, raw_event_len);
+	return REPORT_CONSUMED;
+}
+
+// The type of the interface (used for python scripts)
+// TODO: There has to be a better way to detect which interface is which from userspace, right??
+static ssize_t intf_type (struct device* dev, struct device_attribute* attr, char* buf) {
+	char* type = NULL;
+	struct drvdata* data = dev_get_drvdata(dev);
+	
+	switch (data->inum) {
+		case EXT_INUM: type = "EXT"; break;
+		case KBD_INUM: type = "KBD"; break;
+		case MOUSE_INUM: type = "MOUSE"; break;
+		default: return 0;
+	}
+
+	return snprintf(buf, 8, "%s\n", type);
+}
+
+// The number of profiles the device currently holds
+static ssize_t profile_count_show (struct device* dev, struct device_attribute* attr, char* buf) {
+	struct drvdata* data = dev_get_drvdata(dev);
+	struct kbddata* kdata = data->idata;
+	u8 count = PROFILE_COUNT;
+
+	if (data->inum == KBD_INUM) {
+		rcu_read_lock();
+		count = rcu_dereference(kdata->maps)->count;
+		rcu_read_unlock();
+	}
+
+	return snprintf(buf, 8, "%d\n", count);
+}
+
+// Change the number of profiles (1 - PROFILE_MAX)
+// New profiles start out equal to the base map ; removed profiles are lost
+static ssize_t profile_count_store (struct device* dev, struct device_attribute* attr, const char* buf, size_t len) {
+	struct drvdata* data = dev_get_drvdata(dev);
+	struct kbddata* kdata = data->idata;
+	struct kbdmaps* maps;
+	struct kbdmaps* old;
+	unsigned int count;
+
+	if (data->inum != KBD_INUM) return -EINVAL;
+	if (kstrtouint(buf, 10, &count) || !count || count > PROFILE_MAX) return -EINVAL;
+
+	mutex_lock(&data->lock);
+	old = rcu_dereference_protected(kdata->maps, lockdep_is_held(&data->lock));
+	maps = build_maps(&old->base, old->base_profile <= count ? old->base_profile : 0, count, old, NULL, 0, 0);
+	if (!maps) {
+		mutex_unlock(&data->lock);
+		return -ENOMEM;
+	}
+
+	publish_maps(data, maps);
+	mutex_unlock(&data->lock);
+
+	kvfree_rcu(old, rcu);
+	notify_change(data, NOTIFY_CONFIG);
+	printk(KERN_INFO "HID Tartarus: Resized keyboard to %u profiles\n", count);
+	return len;
+}
+
+// NOTE: buf points to an array of PAGE_SIZE (or 4096 bytes on x86)
+static ssize_t profile_num_show (struct device* dev, struct device_attribute* attr, char* buf) {
+	struct drvdata* data = dev_get_drvdata(dev);
+	return snprintf(buf, 8, "%d\n", READ_ONCE(data->profile)); 
+}
+
+static ssize_t profile_num_store (struct device* dev, struct device_attribute* attr, const char* buf, size_t len) {
+	unsigned long profile;
+	unsigned long flags;
+	u8 count;
+	int status;
+	struct drvdata* data = dev_get_drvdata(dev);
+
+	// Add a null terminator to the input string
+	char nbuf[4] = { 0 };
+	memcpy(nbuf, buf, (len > 3) ? 3 : len);		// nbuf[3] will always remain 0
+	
+	// Convert the provided (base 10) string into a number
+	status = kstrtoul(nbuf, 10, &profile);
+	if (status) { 
+		printk(KERN_WARNING "HID Tartarus: Unable to convert sysfs profile value '%s'\n", nbuf);
+		return len;
+	}
+
+	switch (data->inum) {
+	case KBD_INUM: 
+		spin_lock_irqsave(&data->state_lock, flags);
+		rcu_read_lock();
+
+		// Clamp the profile number to acceptable values
+		count = rcu_dereference(((struct kbddata*) data->idata)->maps)->count;
+		if (profile) profile = (profile - 1) % count + 1;
+
+		// Release all (not already ignored) keys
+		swap_profile_kbd(data, NULL, ~0U);
+		select_profile_kbd(data, profile);
+		if (data->input) input_sync(data->input);
+		publish_state(data, -1);
+
+		rcu_read_unlock();
+		spin_unlock_irqrestore(&data->state_lock, flags);
+		break;
+	}
+	
+	return len;
+}
+
+// Manage the device profile (keymap) itself
+// Outputs the map of the currently selected profile
+static ssize_t profile_show (struct device* dev, struct device_attribute* attr, char* buf) {
+	size_t len = 0;
+	struct drvdata* data = dev_get_drvdata(dev);
+	struct kbddata* kdata;
+	// struct mousedata* mdata;
+	struct kbdmaps* maps;
+	u8 profile;
+
+	switch (data->inum) {
+	case EXT_INUM: break;
+	case KBD_INUM:
+		// Keyboard
+		profile = READ_ONCE(data->profile);
+		if (!profile) break;		// Profile 0 reserved for "no profile"
+		
+		kdata = data->idata;
+		
+		rcu_read_lock();
+		maps = rcu_dereference(kdata->maps);
+		if (profile <= maps->count) {
+			expand_profile_kbd(maps, profile, (struct profile*) buf);
+			len = sizeof(struct profile);
+		}
+		rcu_read_unlock();
+		break;
+
+	case MOUSE_INUM:
+		// Mouse
+		// TODO
+		// mdata = data->idata;
+		// profile = data->profile;		
+		// len = sizeof(struct mprofile);
+		break;
+	}
+
+	return len;
+}
+
+// TODO: Needs testing
+static ssize_t profile_store (struct device* dev, struct device_attribute* attr, const char* buf, size_t len) {
+	struct drvdata* data = dev_get_drvdata(dev);
+	struct kbddata* kdata;
+	// struct mousedata* mdata;
+	struct kbdmaps* maps;
+	struct kbdmaps* old;
+	struct profile* profile;
+	u8 profile_num;
+	size_t bytes = 0;
+	
+	switch (data->inum) {
+	case EXT_INUM: break;
+	case KBD_INUM:
+		profile_num = READ_ONCE(data->profile);
+		if (!profile_num) break;		// Profile 0 reserved for "no profile"
+		
+		bytes = (len > sizeof(struct profile)) ? sizeof(struct profile) : len;
+		kdata = data->idata;
+
+		// TODO: If we change the structure of a profile, we want to assert that len is at least long enough
+		// 		 for essential metadata information (like which lights to use for example)
+		profile = kzalloc(sizeof(struct profile), GFP_KERNEL);
+		if (!profile) return -ENOMEM;
+		memcpy(profile, buf, bytes);
+
+		// Build the new table off to the side so the report path never waits on this copy
+		mutex_lock(&data->lock);
+		old = rcu_dereference_protected(kdata->maps, lockdep_is_held(&data->lock));
+		if (profile_num > old->count || check_profile_kbd(profile, old->count)) {
+			mutex_unlock(&data->lock);
+			kfree(profile);
+			printk(KERN_WARNING "HID Tartarus: Rejected keyboard profile %d (profile or bind out of range)\n", profile_num);
+			return -EINVAL;
+		}
+
+		maps = build_maps(&old->base, old->base_profile, old->count, old, profile, profile_num, 1);
+		kfree(profile);
+		if (!maps) {
+			mutex_unlock(&data->lock);
+			return -ENOMEM;
+		}
+
+		publish_maps(data, maps);
+		mutex_unlock(&data->lock);
+
+		kvfree_rcu(old, rcu);
+		notify_change(data, NOTIFY_CONFIG);
+		printk(KERN_INFO "HID Tartarus: Wrote %lu bytes to keyboard profile %d\n", bytes, profile_num);
+		break;
+
+	case MOUSE_INUM:
+		// TODO
+		break;
+	}
+
+	return len;		// Using bytes here means it will read 1024 and then start over with the next 1024 and so on until all data is consumed
+}
+
+// Profile LED pipeline statistics
+static ssize_t led_stats (struct device* dev, struct device_attribute* attr, char* buf) {
+	struct drvdata* data = dev_get_drvdata(dev);
+	struct ledctl* leds = data->leds;
+	u32 submitted, coalesced, failed;
+	unsigned long flags;
+
+	if (!leds) return 0;
+
+	spin_lock_irqsave(&leds->lock, flags);
+	submitted = leds->submitted;
+	coalesced = leds->coalesced;
+	failed = leds->failed;
+	spin_unlock_irqrestore(&leds->lock, flags);
+
+	return snprintf(buf, PAGE_SIZE, "submitted %u\ncoalesced %u\nfailed %u\n", submitted, coalesced, failed);
+}
+
+// Read the full keyboard configuration (see struct config)
+// Profiles are expanded from their sparse form as they are copied out
+static ssize_t config_read (struct file* file, struct kobject* kobj, BIN_ATTR_T* attr, char* buf, loff_t off, size_t len) {
+	struct drvdata* data = dev_get_drvdata(kobj_to_dev(kobj));
+	struct kbddata* kdata = data->idata;
+	const struct sparsebind* bind;
+	const struct sparsebind* end;
+	struct kbdmaps* maps;
+	size_t copied = 0;
+	size_t bytes;
+	size_t size;
+	size_t skip;
+	size_t pos;
+	int profile;
+	int i;
+
+	struct config header = {
+		.version_major = CFG_VERSION_MAJOR,
+		.version_minor = CFG_VERSION_MINOR,
+	};
+
+	if (data->inum != KBD_INUM) return 0;
+
+	rcu_read_lock();
+	maps = rcu_dereference(kdata->maps);
+	header.num_profiles = maps->count;
+	header.base = maps->base_profile;
+
+	size = sizeof(struct config) + maps->count * sizeof(struct profile);
+	if (off >= size) len = 0;
+	else if (len > size - off) len = size - off;
+
+	// Header
+	if (off < sizeof(struct config) && len) {
+		bytes = min_t(size_t, len, sizeof(struct config) - off);
+		memcpy(buf, (u8*) &header + off, bytes);
+		copied = bytes;
+	}
+
+	// Profiles (base map with each profile's binds on top)
+	while (copied < len) {
+		pos = off + copied - sizeof(struct config);
+		profile = pos / sizeof(struct profile) + 1;
+		skip = pos % sizeof(struct profile);
+		bytes = min_t(size_t, len - copied, sizeof(struct profile) - skip);
+
+		memcpy(buf + copied, (u8*) &maps->base + skip, bytes);
+
+		bind = maps->binds + maps->offset[profile - 1];
+		end = maps->binds + maps->offset[profile];
+		for (; bind < end; ++bind)
+			for (i = 0; i < sizeof(struct bind); ++i) {
+				pos = bind->key * sizeof(struct bind) + i;
+				if (pos >= skip && pos < skip + bytes) buf[copied + pos - skip] = ((const u8*) &bind->bind)[i];
+			}
+
+		copied += bytes;
+	}
+	rcu_read_unlock();
+
+	return len;
+}
+
+// Upload a full keyboard configuration (see struct config)
+// sysfs hands large writes over in page-sized chunks, so they are staged until the whole config has arrived
+// A write at offset 0 always starts a new upload
+static ssize_t config_write (struct file* file, struct kobject* kobj, BIN_ATTR_T* attr, char* buf, loff_t off, size_t len) {
+	struct drvdata* data = dev_get_drvdata(kobj_to_dev(kobj));
+	struct kbddata* kdata = data->idata;
+	struct config* header;
+	size_t expected;
+	ssize_t status = len;
+
+	if (data->inum != KBD_INUM) return -EINVAL;
+
+	mutex_lock(&data->lock);
+	if (!off) {
+		kdata->config_len = 0;
+		if (!kdata->config_buf) kdata->config_buf = kvmalloc(CFG_MAX_LEN, GFP_KERNEL);
+		if (!kdata->config_buf) {
+			status = -ENOMEM;
+			goto config_write_exit;
+		}
+	}
+
+	// Chunks must arrive in order
+	if (!kdata->config_buf || off != kdata->config_len || off + len > CFG_MAX_LEN) {
+		status = -EINVAL;
+		goto config_write_drop;
+	}
+
+	memcpy(kdata->config_buf + off, buf, len);
+	kdata->config_len += len;
+
+	// Wait for the header before we know how much is coming
+	if (kdata->config_len < sizeof(struct config)) goto config_write_exit;
+
+	header = (struct config*) kdata->config_buf;
+	if (!header->num_profiles) {
+		status = -EINVAL;
+		goto config_write_drop;
+	}
+
+	expected = sizeof(struct config) + header->num_profiles * sizeof(struct profile);
+
+	if (kdata->config_len < expected) goto config_write_exit;
+	if ((status = load_config(data, kdata->config_buf, kdata->config_len)) == 0) status = len;
+
+config_write_drop:
+	kvfree(kdata->config_buf);
+	kdata->config_buf = NULL;
+	kdata->config_len = 0;
+
+config_write_exit:
+	mutex_unlock(&data->lock);
+	return status;
+}
+
+// Validate and publish a full keyboard configuration
+// The new profiles are swapped in atomically: the active profile number, held keys, and LEDs are untouched
+// (unless the active profile no longer exists)
+// NOTE: data->lock must be held
+static int load_config (struct drvdata* data, const u8* blob, size_t len) {
+	struct kbdmaps* maps;
+	struct kbdmaps* old;
+	int status;
+
+	if ((status = decode_config(blob, len, &maps))) return status;
+
+	old = publish_maps(data, maps);
+	kvfree_rcu(old, rcu);
+
+	notify_change(data, NOTIFY_CONFIG);
+	printk(KERN_INFO "HID Tartarus: Loaded config (%d profiles, %d sparse binds)\n", maps->count, maps->len);
+	return 0;
+}
+
+// Validate a full keyboard configuration and build its profile table
+static int decode_config (const u8* blob, size_t len, struct kbdmaps** out) {
+	const struct config* header = (const struct config*) blob;
+	const struct profile* base;
+	struct kbdmaps* maps;
+	int i;
+
+	if (len < sizeof(struct config)) return -EINVAL;
+	if (header->version_major != CFG_VERSION_MAJOR) {
+		printk(KERN_WARNING "HID Tartarus: Unsupported config version %d.%d\n", header->version_major, header->version_minor);
+		return -EINVAL;
+	}
+
+	if (!header->num_profiles || header->num_macros || header->base > header->num_profiles) return -EINVAL;
+	if (len != sizeof(struct config) + header->num_profiles * sizeof(struct profile)) return -EINVAL;
+
+	for (i = 0; i < header->num_profiles; ++i)
+		if (check_profile_kbd(header->profiles + i, header->num_profiles)) {
+			printk(KERN_WARNING "HID Tartarus: Rejected config (profile %d has a bind out of range)\n", i + 1);
+			return -EINVAL;
+		}
+
+	base = header->base ? header->profiles + header->base - 1 : NULL;
+	maps = build_maps(base, header->base, header->num_profiles, NULL, header->profiles, 1, header->num_profiles);
+	if (!maps) return -ENOMEM;
+
+	*out = maps;
+	return 0;
+}
+
+// Build a sparse profile table (see struct kbdmaps)
+// base -> Map shared by every profile (NULL -> Empty) ; must be old's base map when old is given
+// Profiles first to first + num - 1 are encoded from dense, the others are copied over from old
+// or start out equal to the base map if old does not have them
+static struct kbdmaps* build_maps (const struct profile* base, u8 base_profile, u8 count,
+		const struct kbdmaps* old, const struct profile* dense, u8 first, u8 num) {
+	struct kbdmaps* maps;
+	size_t len = 0;
+	int size;
+	int i;
+
+	// Size the table first so it takes a single allocation
+	for (i = 1; i <= count; ++i) {
+		if (i >= first && i < first + num) len += pack_profile_kbd(base, dense + i - first, NULL);
+		else if (old && i <= old->count) len += old->offset[i] - old->offset[i - 1];
+	}
+
+	maps = kvzalloc(sizeof(struct kbdmaps) + (count + 1) * sizeof(u16) + len * sizeof(struct sparsebind), GFP_KERNEL);
+	if (!maps) return NULL;
+
+	maps->count = count;
+	maps->base_profile = base_profile;
+	maps->len = len;
+	maps->binds = (struct sparsebind*) (maps->offset + count + 1);
+	if (base) memcpy(&maps->base, base, sizeof(struct profile));
+
+	for (i = 1, len = 0; i <= count; ++i) {
+		if (i >= first && i < first + num) len += pack_profile_kbd(base, dense + i - first, maps->binds + len);
+		else if (old && i <= old->count) {
+			size = old->offset[i] - old->offset[i - 1];
+			memcpy(maps->binds + len, old->binds + old->offset[i - 1], size * sizeof(struct sparsebind));
+			len += size;
+		}
+
+		maps->offset[i] = len;
+	}
+
+	return maps;
+}
+
+// Swap in a new keymap table and rebuild the active layers from it
+// A base profile which no longer exists falls back to profile 1
+// Returns the old table, to be freed once readers are done with it (kvfree_rcu)
+// NOTE: data->lock must be held
+static struct kbdmaps* publish_maps (struct drvdata* data, struct kbdmaps* maps) {
+	struct kbddata* kdata = data->idata;
+	struct kbdmaps* old = rcu_dereference_protected(kdata->maps, lockdep_is_held(&data->lock));
+	unsigned long flags;
+
+	spin_lock_irqsave(&data->state_lock, flags);
+	rcu_read_lock();
+	rcu_assign_pointer(kdata->maps, maps);
+	flush_swaps_kbd(data);
+	if (kdata->layers.profile[0] > maps->count) {
+		select_profile_kbd(data, 1);
+		if (data->input) input_sync(data->input);
+		publish_state(data, -1);
+	} else flatten_layers_kbd(data, 0);
+	rcu_read_unlock();
+	spin_unlock_irqrestore(&data->state_lock, flags);
+
+	return old;
+}
+
+// Read the macro table (see struct macrocfg)
+static ssize_t macros_read (struct file* file, struct kobject* kobj, BIN_ATTR_T* attr, char* buf, loff_t off, size_t len) {
+	struct drvdata* data = dev_get_drvdata(kobj_to_dev(kobj));
+	struct kbddata* kdata = data->idata;
+	struct macros* macros;
+	struct macrocfg header = {
+		.version_major = MCR_VERSION_MAJOR,
+		.version_minor = MCR_VERSION_MINOR,
+	};
+
+	size_t total;
+	size_t copied = 0;
+	size_t bytes;
+
+	if (data->inum != KBD_INUM) return 0;
+
+	rcu_read_lock();
+	macros = rcu_dereference(kdata->macros);
+	if (macros) {
+		header.len = macros->len;
+		memcpy(header.size, macros->size, sizeof(header.size));
+	}
+
+	total = sizeof(struct macrocfg) + header.len;
+	if (off >= total) goto macros_read_exit;
+	if (len > total - off) len = total - off;
+
+	// Header
+	if (off < sizeof(struct macrocfg)) {
+		bytes = min_t(size_t, len, sizeof(struct macrocfg) - off);
+		memcpy(buf, (u8*) &header + off, bytes);
+		copied = bytes;
+	}
+
+	// Code (macros are stored back to back)
+	if (copied < len) memcpy(buf + copied, macros->code + off + copied - sizeof(struct macrocfg), len - copied);
+	copied = len;
+
+macros_read_exit:
+	rcu_read_unlock();
+	return copied;
+}
+
+// Upload the macro table (see struct macrocfg)
+// The table always fits within a single page, so it must arrive in a single write
+static ssize_t macros_write (struct file* file, struct kobject* kobj, BIN_ATTR_T* attr, char* buf, loff_t off, size_t len) {
+	struct drvdata* data = dev_get_drvdata(kobj_to_dev(kobj));
+	int status;
+
+	if (data->inum != KBD_INUM || off) return -EINVAL;
+
+	mutex_lock(&data->lock);
+	status = load_macros(data, buf, len);
+	mutex_unlock(&data->lock);
+
+	return status ? status : len;
+}
+
+// Validate and publish a macro table
+// Whatever macro is playing is stopped (and its keys released) since its code goes away
+// NOTE: data->lock must be held
+static int load_macros (struct drvdata* data, const u8* blob, size_t len) {
+	struct kbddata* kdata = data->idata;
+	struct macros* macros;
+	struct macros* old;
+	unsigned long flags;
+	int status;
+
+	if ((status = decode_macros(blob, len, &macros))) return status;
+
+	spin_lock_irqsave(&data->state_lock, flags);
+	old = rcu_dereference_protected(kdata->macros, lockdep_is_held(&data->lock));
+	stop_macro(data);
+	if (data->input) input_sync(data->input);
+	rcu_assign_pointer(kdata->macros, macros);
+	spin_unlock_irqrestore(&data->state_lock, flags);
+
+	if (old) kfree_rcu(old, rcu);
+
+	notify_change(data, NOTIFY_MACROS);
+	printk(KERN_INFO "HID Tartarus: Loaded macros (%d bytes)\n", macros->len);
+	return 0;
+}
+
+// Validate a macro table and compile it
+static int decode_macros (const u8* blob, size_t len, struct macros** out) {
+	const struct macrocfg* header = (const struct macrocfg*) blob;
+	struct macros* macros;
+	u32 offset = 0;
+	int i;
+
+	if (len < sizeof(struct macrocfg)) return -EINVAL;
+	if (header->version_major != MCR_VERSION_MAJOR) {
+		printk(KERN_WARNING "HID Tartarus: Unsupported macro version %d.%d\n", header->version_major, header->version_minor);
+		return -EINVAL;
+	}
+
+	if (header->len > MACRO_CODE_LEN || len != sizeof(struct macrocfg) + header->len) return -EINVAL;
+
+	macros = kzalloc(sizeof(struct macros), GFP_KERNEL);
+	if (!macros) return -ENOMEM;
+
+	macros->len = header->len;
+	memcpy(macros->code, header->code, header->len);
+	for (i = 0; i < MACRO_COUNT; ++i) {
+		macros->offset[i] = offset;
+		macros->size[i] = header->size[i];
+		offset += header->size[i];
+	}
+
+	if (offset > header->len || check_macros(macros)) {
+		kfree(macros);
+		printk(KERN_WARNING "HID Tartarus: Rejected macros (malformed bytecode)\n");
+		return -EINVAL;
+	}
+
+	*out = macros;
+	return 0;
+}
+
+// Snapshot of the shared state page (for tools which would rather not mmap)
+static ssize_t state_read (struct file* file, struct kobject* kobj, BIN_ATTR_T* attr, char* buf, loff_t off, size_t len) {
+	struct drvdata* data = dev_get_drvdata(kobj_to_dev(kobj));
+	unsigned long flags;
+
+	if (!data->state || off >= sizeof(struct statepage)) return 0;
+	if (len > sizeof(struct statepage) - off) len = sizeof(struct statepage) - off;
+
+	spin_lock_irqsave(&data->state_lock, flags);
+	memcpy(buf, (u8*) data->state + off, len);
+	spin_unlock_irqrestore(&data->state_lock, flags);
+
+	return len;
+}
+
+// Map the shared state page (read-only)
+// NOTE: sysfs revokes the mapping when the file is removed, so the page may be freed on disconnect
+static int state_mmap (struct file* file, struct kobject* kobj, BIN_ATTR_T* attr, struct vm_area_struct* vma) {
+	struct drvdata* data = dev_get_drvdata(kobj_to_dev(kobj));
+
+	if (!data->state || vma->vm_pgoff || vma->vm_end - vma->vm_start > PAGE_SIZE) return -EINVAL;
+	if (vma->vm_flags & VM_WRITE) return -EPERM;
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 3, 0)
+	vm_flags_clear(vma, VM_MAYWRITE);
+#else
+	vma->vm_flags &= ~VM_MAYWRITE;
+#endif
+
+	return vm_insert_page(vma, vma->vm_start, virt_to_page(data->state));
+}
+
+// Publish the device state to the shared state page
+// events -> Key events decoded from the report just handled ; -1 -> State change outside of a report
+// NOTE: Caller must hold state_lock
+void publish_state (struct drvdata* data, int events) {
+	struct statepage* state = data->state;
+	struct kbddata* kdata;
+	struct layers* layers;
+	u8 shift;
+	u8 revert;
+
+	// Only the keyboard interface has a state page (and kbddata)
+	if (!state || data->inum != KBD_INUM) return;
+
+	kdata = data->idata;
+	layers = &kdata->layers;
+	shift = layers->depth ? layers->profile[layers->depth] : 0;
+	revert = layers->depth ? layers->profile[0] : 0;
+
+	// Wake pollers only upon changes they care about (never for plain key events)
+	if (state->profile != data->profile) notify_change(data, NOTIFY_PROFILE);
+	if (state->profile != data->profile || state->shift != shift || state->revert != revert)
+		notify_change(data, NOTIFY_STATE);
+
+	WRITE_ONCE(state->seq, state->seq + 1);
+	smp_wmb();
+
+	state->profile = data->profile;
+	state->shift = shift;
+	state->revert = revert;
+	if (events >= 0) {
+		++state->reports;
+		state->events += events;
+	}
+
+	// Modifier keys use the same (MODKEY_MASK) indices as the keymap
+	state->keys = kdata->held;
+
+	smp_wmb();
+	WRITE_ONCE(state->seq, state->seq + 1);
+}
+
+// Queue a sysfs notification (wakes poll() on the respective file)
+// sysfs_notify() may sleep, so it is raised from a work item instead of the report path
+// Several changes before the work runs result in one wakeup
+void notify_change (struct drvdata* data, int what) {
+	set_bit(what, &data->notify);
+	schedule_work(&data->notify_work);
+}
+
+void notify_work (struct work_struct* work) {
+	struct drvdata* data = container_of(work, struct drvdata, notify_work);
+
+	if (test_and_clear_bit(NOTIFY_PROFILE, &data->notify)) sysfs_notify(&data->dev->kobj, NULL, "profile_num");
+	if (test_and_clear_bit(NOTIFY_STATE, &data->notify)) sysfs_notify(&data->dev->kobj, NULL, "state");
+	if (test_and_clear_bit(NOTIFY_CONFIG, &data->notify)) sysfs_notify(&data->dev->kobj, NULL, "config");
+	if (test_and_clear_bit(NOTIFY_MACROS, &data->notify)) sysfs_notify(&data->dev->kobj, NULL, "macros");
+}
+
+// -- DEBUGFS --
+// Per-interface directory: /sys/kernel/debug/tartarus/<hid device>/
+static void debugfs_init (struct hid_device* dev, struct drvdata* data) {
+	data->debug_dir = debugfs_create_dir(dev_name(&dev->dev), debug_root);
+	debugfs_create_file("latency", 0444, data->debug_dir, data, &latency_fops);
+	debugfs_create_file("latency_reset", 0200, data->debug_dir, data, &latency_reset_fops);
+	if (data->inum == KBD_INUM) debugfs_create_file("swaps", 0444, data->debug_dir, data, &swaps_fops);
+	if (data->inum == KBD_INUM) debugfs_create_file("commands", 0444, data->debug_dir, data, &commands_fops);
+	debugfs_create_file("jitter", 0444, data->debug_dir, data, &jitter_fops);
+}
+
+// Record the time elapsed since start (latency_start()) for one stage
+// Only the local CPU's histogram is touched
+void latency_record (struct drvdata* data, u8 stage, u64 start) {
+	u64 delta = ktime_get_ns() - start;
+	int bucket = fls64(delta);
+
+	if (bucket >= LAT_BUCKETS) bucket = LAT_BUCKETS - 1;
+	this_cpu_inc(data->lat->hist[stage][bucket]);
+}
+
+// Print the latency histograms (summed over every CPU)
+static int latency_show (struct seq_file* file, void* unused) {
+	static const char* stages[LAT_STAGES] = { "report", "decode", "resolve", "swap", "command", "resume" };
+	struct drvdata* data = file->private;
+	u64 hist[LAT_BUCKETS];
+	u64 total;
+	int stage;
+	int cpu;
+	int i;
+
+	for (stage = 0; stage < LAT_STAGES; ++stage) {
+		memset(hist, 0, sizeof(hist));
+		total = 0;
+
+		for_each_possible_cpu(cpu)
+			for (i = 0; i < LAT_BUCKETS; ++i)
+				hist[i] += per_cpu_ptr(data->lat, cpu)->hist[stage][i];
+
+		for (i = 0; i < LAT_BUCKETS; ++i) total += hist[i];
+		seq_printf(file, "%s (%llu samples)\n", stages[stage], total);
+
+		for (i = 0; i < LAT_BUCKETS; ++i) {
+			if (!hist[i]) continue;
+			seq_printf(file, "\t%10llu - %10llu ns : %llu\n", i ? 1ULL << (i - 1) : 0, (1ULL << i) - 1, hist[i]);
+		}
+	}
+
+	return 0;
+}
+
+// Any write clears every histogram (report arrival jitter included)
+static ssize_t latency_reset (struct file* file, const char __user* buf, size_t len, loff_t* off) {
+	struct drvdata* data = file->private_data;
+	struct jitter* jit = data->jitter;
+	unsigned long flags;
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		memset(per_cpu_ptr(data->lat, cpu), 0, sizeof(struct latency));
+
+	spin_lock_irqsave(&data->state_lock, flags);
+	jit->reports = 0;
+	jit->max_ns = 0;
+	jit->min_gap_ns = 0;
+	jit->window_reports = 0;
+	jit->peak_hz = 0;
+	memset(jit->hist, 0, sizeof(jit->hist));
+	spin_unlock_irqrestore(&data->state_lock, flags);
+
+	return len;
+}
+
+// Account the arrival of a report (now, in ns) against the polling grid of its interface, and towards its report rate
+// NOTE: state_lock must be held
+static void jitter_record (struct jitter* jit, u64 now) {
+	u32 interval = jit->interval_us * NSEC_PER_USEC;
+	u64 gap = now - jit->last_ns;
+	u32 offset;
+	int bucket;
+
+	if (jit->last_ns && (!jit->min_gap_ns || gap < jit->min_gap_ns)) jit->min_gap_ns = gap;
+
+	// Reports within one second of the report opening each window (which only marks its start)
+	if (now - jit->window_ns >= NSEC_PER_SEC) {
+		jit->window_ns = now;
+		jit->window_reports = 0;
+	}
+	else if (++jit->window_reports > jit->peak_hz) jit->peak_hz = jit->window_reports;
+
+	if (jit->last_ns && interval) {
+		offset = do_div(gap, interval);
+		if (offset > interval / 2) offset = interval - offset;
+
+		bucket = fls(offset);
+		if (bucket >= LAT_BUCKETS) bucket = LAT_BUCKETS - 1;
+		++jit->hist[bucket];
+		if (offset > jit->max_ns) jit->max_ns = offset;
+	}
+
+	jit->last_ns = now;
+	++jit->reports;
+}
+
+// Report arrival jitter: offsets of the gaps between reports from a whole number of polling intervals
+static int jitter_show (struct seq_file* file, void* unused) {
+	struct drvdata* data = file->private;
+	struct jitter jit;
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&data->state_lock, flags);
+	jit = *data->jitter;
+	spin_unlock_irqrestore(&data->state_lock, flags);
+
+	seq_printf(file, "interval_us %u\nreports %llu\nmin_gap_ns %llu\npeak_hz %u\nmax_ns %llu\n",
+		jit.interval_us, jit.reports, jit.min_gap_ns, jit.peak_hz, jit.max_ns);
+
+	for (i = 0; i < LAT_BUCKETS; ++i) {
+		if (!jit.hist[i]) continue;
+		seq_printf(file, "\t%10llu - %10llu ns : %llu\n", i ? 1ULL << (i - 1) : 0, (1ULL << i) - 1, jit.hist[i]);
+	}
+
+	return 0;
+}
+
+// Profile swap statistics (keyboard only)
+static int swaps_show (struct seq_file* file, void* unused) {
+	struct drvdata* data = file->private;
+	struct kbddata* kdata = data->idata;
+	struct swapstats stats;
+	unsigned long flags;
+
+	spin_lock_irqsave(&data->state_lock, flags);
+	stats = kdata->swapstats;
+	spin_unlock_irqrestore(&data->state_lock, flags);
+
+	seq_printf(file, "swaps %u\ncached %u\nrewritten %u\nignored %u\nskipped %u\n",
+		stats.swaps, stats.hits, stats.rewritten, stats.ignored, stats.skipped);
+	return 0;
+}
+
+// Device command statistics (keyboard only)
+// One line per command (class:id) ; times are from queued to completed, in microseconds
+static int commands_show (struct seq_file* file, void* unused) {
+	struct drvdata* data = file->private;
+	struct cmdqueue* q = data->cmdq;
+	struct cmdstats stats[CMD_STATS];
+	unsigned long flags;
+	u32 overflow;
+	int i;
+
+	if (!q) return 0;
+
+	spin_lock_irqsave(&q->lock, flags);
+	memcpy(stats, q->stats, sizeof(stats));
+	overflow = q->overflow;
+	spin_unlock_irqrestore(&q->lock, flags);
+
+	for (i = 0; i < CMD_STATS && stats[i].count; ++i) {
+		seq_printf(file, "0x%02x:0x%02x count %u busy %u failed %u avg_us %llu max_us %llu\n",
+			stats[i].class, stats[i].id, stats[i].count, stats[i].busy, stats[i].failed,
+			div_u64(div_u64(stats[i].total_ns, stats[i].count), 1000), div_u64(stats[i].max_ns, 1000));
+	}
+
+	seq_printf(file, "overflow %u\n", overflow);
+	return 0;
+}
+
+// -- CONFIG CACHE --
+// Profiles outlive the pad: disconnect leaves them here so that a replug or re-enumeration comes back with them
+// Only the module's lifetime is covered ; after a reload, the profile pack (if any) takes over
+// Identify a pad by its serial number (uniq) if it reports one, otherwise by where it is plugged in (phys)
+static const char* cache_key (struct hid_device* dev) {
+	return dev->uniq[0] ? dev->uniq : dev->phys;
+}
+
+// Take back the profiles, macros, and active profile a pad was disconnected with
+// Returns 0 if there were any (the cache entry is consumed), -ENOENT otherwise
+static int cache_restore (struct hid_device* dev, struct kbdmaps** maps, struct macros** macros, u8* profile) {
+	const char* key = cache_key(dev);
+	struct cfgcache* entry;
+	int status = -ENOENT;
+
+	mutex_lock(&config_cache_lock);
+	list_for_each_entry(entry, &config_cache, list) {
+		if (strncmp(entry->key, key, CACHE_KEY_LEN)) continue;
+
+		*maps = entry->maps;
+		*macros = entry->macros;
+		*profile = entry->profile;
+
+		list_del(&entry->list);
+		kfree(entry);
+		status = 0;
+		break;
+	}
+	mutex_unlock(&config_cache_lock);
+
+	return status;
+}
+
+// Keep the profiles and macros of a disconnecting pad (they are cleared from kdata, so the caller no longer frees them)
+// NOTE: The report path must no longer run (i.e. call once the device is stopped)
+static void cache_store (struct hid_device* dev, struct drvdata* data) {
+	struct kbddata* kdata = data->idata;
+
+	// (data->profile is already 0 for lights off)
+	if (cache_insert(dev, rcu_dereference_protected(kdata->maps, 1), rcu_dereference_protected(kdata->macros, 1),
+			kdata->layers.profile[0])) return;
+
+	RCU_INIT_POINTER(kdata->maps, NULL);
+	RCU_INIT_POINTER(kdata->macros, NULL);
+}
+
+// Hand profiles and macros over to the cache (i.e. back from a probe which restored them and failed)
+// The least recently stored pad is dropped past CACHE_DEVICES
+// Returns 0 once the cache owns them, -ENOMEM if memory is short (nothing is kept and the caller still owns them)
+static int cache_insert (struct hid_device* dev, struct kbdmaps* maps, struct macros* macros, u8 profile) {
+	struct cfgcache* entry;
+	struct cfgcache* old;
+	struct cfgcache* tmp;
+	int count = 0;
+
+	entry = kzalloc(sizeof(struct cfgcache), GFP_KERNEL);
+	if (!entry) return -ENOMEM;
+
+	strscpy(entry->key, cache_key(dev), CACHE_KEY_LEN);
+	entry->maps = maps;
+	entry->macros = macros;
+	entry->profile = profile;
+
+	mutex_lock(&config_cache_lock);
+	list_for_each_entry_safe(old, tmp, &config_cache, list) {
+		if (strncmp(old->key, entry->key, CACHE_KEY_LEN) && ++count < CACHE_DEVICES) continue;
+		list_del(&old->list);
+		cache_free(old);
+	}
+	list_add(&entry->list, &config_cache);
+	mutex_unlock(&config_cache_lock);
+	return 0;
+}
+
+// Drop every cached pad (module unload)
+static void cache_clear (void) {
+	struct cfgcache* entry;
+	struct cfgcache* tmp;
+
+	list_for_each_entry_safe(entry, tmp, &config_cache, list) {
+		list_del(&entry->list);
+		cache_free(entry);
+	}
+}
+
+static void cache_free (struct cfgcache* entry) {
+	kvfree(entry->maps);
+	kfree(entry->macros);
+	kfree(entry);
+}
+
+// Load the profile pack (firmware file named by the profile_pack parameter)
+// It holds a config exactly as written to 'config', optionally followed by macros exactly as written to 'macros'
+// (i.e. `linapse.py -P <file> -C <profiles> [-M <macros>]`)
+static int load_pack (struct hid_device* dev, struct kbdmaps** maps, struct macros** macros) {
+	const struct firmware* fw;
+	const struct config* header;
+	size_t len;
+	int status;
+
+	if (!profile_pack || !profile_pack[0]) return -ENOENT;
+
+	// NOTE: Never falls back to the usermode helper, so a missing pack costs a file lookup rather than a timeout
+	if ((status = request_firmware_direct(&fw, profile_pack, &dev->dev))) return status;
+
+	status = -EINVAL;
+	header = (const struct config*) fw->data;
+	if (fw->size < sizeof(struct config)) goto load_pack_exit;
+
+	len = sizeof(struct config) + header->num_profiles * sizeof(struct profile);
+	if (len > fw->size) goto load_pack_exit;
+
+	if ((status = decode_config(fw->data, len, maps))) goto load_pack_exit;
+	if (len < fw->size && (status = decode_macros(fw->data + len, fw->size - len, macros))) {
+		kvfree(*maps);
+		*maps = NULL;
+	}
+
+load_pack_exit:
+	if (status) printk(KERN_WARNING "HID Tartarus: Rejected profile pack '%s' (status: %d)\n", profile_pack, status);
+	else printk(KERN_INFO "HID Tartarus: Loaded profile pack '%s' (%d profiles)\n", profile_pack, header->num_profiles);
+
+	release_firmware(fw);
+	return status;
+}
+
+
+// -- INPUT PROCESSING --
+// Log the output of a raw event for debugging
+void log_event (u8* data, int len_data, u8 inum) {
+	int i;
+	int j;
+	unsigned mask = 0x80;
+	// static int num = 0;		// (DEBUG)
+
+	char* bits_str = kzalloc(9 * sizeof(char), GFP_KERNEL);
+	char* data_str = kzalloc((10 * len_data + 1) * sizeof(char), GFP_KERNEL);
+
+	// I'm kinda cheating here, but this routine won't be used within the release build of the module
+	if (!bits_str || !data_str) {
+		printk(KERN_WARNING "HID Tartarus: Ran out of memory while logging device event (inum: %d)\n", inum);
+		return;
+	}
+
+ 	// Bits output version
+	for (i = 0; i < len_data; ++i) {
+		for (j = 0; j < 8; ++j)
+			snprintf(bits_str + j, 2, "%u", !!(data[i] & (mask >> j)));
+		snprintf(data_str + (i * 10), 11, "%s%s", bits_str, /*((i + 1) % 8) ? "  " : " \n"*/ "  ");
+	}
+	printk(KERN_INFO "RAW EVENT:  inum: %d  size: %d  data:\n\t%s\n", inum, len_data, data_str);
+
+	/*/ Hex output version
+	for (i = 2; i < len_data; ++i) {
+		if (!data[i]) {
+			if (i == 2) sprintf(data_str, "EMPTY");
+			break;
+		}
+		snprintf(data_str + (i - 2) * 5, 6, "0x%02x ", data[i]);
+	}
+	printk(KERN_INFO "EVENT %d: %s\n", ++num, data_str); //*/
+
+	kfree(bits_str);
+	kfree(data_str);
+}
+
+// Set device profile number and lights
+void set_profile (struct drvdata* data, u8 profile) {
+	// Only the keyboard interface has an LED pipeline
+	// Three LEDs count profiles 1 - 7 in binary ; every profile past that lights all three rather than wrapping around
+	if (data->leds) set_profile_led(data, min_t(u8, profile, LED_MASK));
+
+	data->profile = profile;
+}
+
+
+// -- MACROS --
+// Prepare the macro sequencer
+int init_macro (struct drvdata* data) {
+	struct macroctl* ctl = kzalloc(sizeof(struct macroctl), GFP_KERNEL);
+	if (!ctl) return -ENOMEM;
+
+	// NOTE: Soft mode runs the sequencer from softirq context (input_event() may not run in hard IRQ on PREEMPT_RT)
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 13, 0)
+	hrtimer_setup(&ctl->timer, macro_timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS_SOFT);
+#else
+	hrtimer_init(&ctl->timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS_SOFT);
+	ctl->timer.function = macro_timer;
+#endif
+
+	ctl->data = data;
+	data->macro = ctl;
+	return 0;
+}
+
+// Release the macro sequencer
+// It is detached under state_lock first, so neither a report nor a sysfs write can start a macro on it again
+// NOTE: The timer uses the input device, so this must run before hid_hw_stop()
+void free_macro (struct drvdata* data) {
+	struct macroctl* ctl = data->macro;
+	unsigned long flags;
+
+	if (!ctl) return;
+
+	spin_lock_irqsave(&data->state_lock, flags);
+	data->macro = NULL;
+	spin_unlock_irqrestore(&data->state_lock, flags);
+
+	hrtimer_cancel(&ctl->timer);
+	kfree(ctl);
+}
+
+// Start or release a macro (called from the translation core upon a CTRL_MACRO bind)
+// The first steps run right away so the first keystroke shares the input frame of the key which triggered it
+// NOTE: Caller must hold state_lock and rcu_read_lock()
+int play_macro (struct drvdata* data, u8 macro, u8 state) {
+	struct kbddata* kdata = data->idata;
+	struct macros* macros = rcu_dereference(kdata->macros);
+
+	if (!data->macro || !macros || macro >= MACRO_COUNT || !macros->size[macro]) return -ENOENT;
+
+	// Release only ends loops which run while held
+	if (!state) {
+		if (kdata->play.active && kdata->play.macro == macro) kdata->play.held = 0;
+		return 0;
+	}
+
+	start_macro(data, macro);
+	kdata->play.due = ktime_get_ns();
+	schedule_macro(data);
+
+	return 0;
+}
+
+// Run the macro up to its next delay and arm the timer for the step after
+// NOTE: Caller must hold state_lock and rcu_read_lock()
+void schedule_macro (struct drvdata* data) {
+	struct kbddata* kdata = data->idata;
+	int delay = run_macro(data);
+	u64 now;
+
+	if (delay < 0) return;
+
+	// Deadlines advance from the previous deadline (not from now) so timer latency never accumulates
+	// Only if we fell behind entirely does the next step run from now
+	now = ktime_get_ns();
+	kdata->play.due += (u64) delay * NSEC_PER_MSEC;
+	if (kdata->play.due < now) kdata->play.due = now;
+
+	hrtimer_start(&data->macro->timer, ns_to_ktime(kdata->play.due), HRTIMER_MODE_ABS_SOFT);
+}
+
+enum hrtimer_restart macro_timer (struct hrtimer* timer) {
+	struct macroctl* ctl = container_of(timer, struct macroctl, timer);
+	struct drvdata* data = ctl->data;
+	struct kbddata* kdata = data->idata;
+	unsigned long flags;
+
+	spin_lock_irqsave(&data->state_lock, flags);
+	rcu_read_lock();
+
+	// A macro started while we waited for the lock has already armed the timer for itself
+	// Its events carry the time they were due rather than the time the timer got to run
+	// (No sequencer -> Being freed: the macro ends here)
+	if (kdata->play.active && data->macro && !hrtimer_is_queued(timer)) {
+		input_set_timestamp(data->input, ns_to_ktime(kdata->play.due));
+		schedule_macro(data);
+		input_sync(data->input);
+	}
+
+	rcu_read_unlock();
+	spin_unlock_irqrestore(&data->state_lock, flags);
+
+	return HRTIMER_NORESTART;
+}
+
+
+// -- DEVICE COMMANDS --
+// Log the a razer report struct to the kernel (for debugging)
+void log_report (struct razer_report* report) {
+	char* status_str;
+	char* params_str;
+	int i;
+
+	// Status
+	switch (report->status) {
+	case 0x00:
+		status_str = "New Command (0x00)";
+		break;
+	case 0x01:
+		status_str = "Device Busy (0x01)";
+		break;
+	case 0x02:
+		status_str = "Success (0x02)";
+		break;
+	case 0x03:
+		status_str = "Failure (0x03)";
+		break;
+	case 0x04:
+		status_str = "Timeout (0x04)";
+		break;
+	case 0x05:
+		status_str = "Not Supported (0x05)";
+		break;
+	default:
+		status_str = "Unexpected status (0x??)";
+	}
+	
+	// Command params (data)
+	// Length of param string: 80 * 2 hex chars, + (80 / 2) * 2 spaces + 1 null = 241
+	params_str = kzalloc(241 * sizeof(char), GFP_KERNEL);
+	if (!params_str) return;
+	for (i = 0; i < 80; i += 2)
+		snprintf(params_str + (3 * i), 7, "%02x%02x%s", report->data[i], report->data[i + 1], ((i + 2) % 16) ? "  " : "\n\t");
+
+	printk(KERN_INFO "HID TARTARUS DEBUG INFORMATION:\n\n\
+		\tTransaction ID: 0x%02x\
+		\tStatus: %s\n\
+		\tCommand ID: 0x%02x\
+		\tClass: 0x%02x\n\
+		\tSize: 0x%02x (%d)\t\tRemaining Packets: 0x%02x (%d)\n\n\
+		\tData: 0x\n\t%s\n",
+		   report->tr_id.id,
+		   status_str,
+		   report->cmd_id.id,
+		   report->class,
+		   report->size, report->size,
+		   report->remaining, report->remaining,
+		   params_str);
+
+	kfree(params_str);
+}
+
+// Calculate report checksum (razer_checksum)
+// (Taken from OpenRazer driver)
+unsigned char report_checksum (struct razer_report* report) {
+	unsigned char ck = 0;
+	unsigned char* bytes = (unsigned char*) report;
+
+	for (int i = 2; i < 88; i++) ck ^= bytes[i];
+	return ck;
+}
+
+// Create a razer report data type
+// Specifically for use in requesting data from the device
+// (Modified from OpenRazer)
+struct razer_report init_report (unsigned char class, unsigned char id, unsigned char size) {
+	struct razer_report report = { 0 };
+	// Static values
+	report.tr_id.id = 0xFF;		// (What OpenRazer sends this pad ; the firmware is not known to echo any other)
+	// report.status = 0x00;
+	// report.remaining = 0x00;
+	// report.protocol_type = 0x00;
+
+	// Command parameters
+	report.class = class;
+	report.cmd_id.id = id;
+	report.size = size;
+
+	return report;
+}
+
+// Prepare the device command queue
+// Everything a command needs is allocated here, so queueing one never allocates
+int init_command_queue (struct drvdata* data) {
+	struct cmdqueue* q;
+	int status;
+
+	q = kzalloc(sizeof(struct cmdqueue), GFP_KERNEL);
+	if (!q) return -ENOMEM;
+
+	// NOTE: The buffers will be read from direct memory access (DMA) so they must not share the queue allocation
+	q->context = kzalloc(sizeof(struct urb_context), GFP_KERNEL);
+	if (!q->context) {
+		kfree(q);
+		return -ENOMEM;
+	}
+
+	spin_lock_init(&q->lock);
+	init_waitqueue_head(&q->idle);
+	q->data = data;
+
+	// NOTE: Soft mode runs the timer from softirq context, like the URB completions it chains with
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 13, 0)
+	hrtimer_setup(&q->timer, command_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL_SOFT);
+#else
+	hrtimer_init(&q->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL_SOFT);
+	q->timer.function = command_timer;
+#endif
+
+	data->cmdq = q;
+
+	if ((status = data->ctrl->open(data))) {
+		kfree(q->context);
+		kfree(q);
+		data->cmdq = NULL;
+	}
+
+	return status;
+}
+
+// Release the device command queue
+// Commands already queued get a moment to finish (i.e. the final lights off) ; any left over fail with -ESHUTDOWN
+// NOTE: Must not race with queue_command() callers which still expect their command to run (i.e. call once the device is stopped)
+void free_command_queue (struct drvdata* data) {
+	struct cmdqueue* q = data->cmdq;
+	struct command* cmd;
+	unsigned long flags;
+
+	if (!q) return;
+
+	drain_command_queue(data, 100);
+
+	spin_lock_irqsave(&q->lock, flags);
+	q->dead = 1;
+	spin_unlock_irqrestore(&q->lock, flags);
+
+	// Once the backend is closed, any transfer the timer still starts fails right away
+	data->ctrl->close(data);
+	hrtimer_cancel(&q->timer);
+	usb_free_urb(q->urb);		// (NULL unless the USB backend)
+
+	for (; q->len; --q->len, q->head = (q->head + 1) & (CMD_SLOTS - 1)) {
+		cmd = &q->cmds[q->head];
+		if (cmd->done) cmd->done(data, cmd->ctx, NULL, -ESHUTDOWN);
+	}
+
+	if (q->awake) data->ctrl->put(data);
+
+	data->cmdq = NULL;
+	kfree(q->context);
+	kfree(q);
+}
+
+// Wait (up to ms) for the commands already queued to finish
+// NOTE: Process context only
+void drain_command_queue (struct drvdata* data, unsigned int ms) {
+	struct cmdqueue* q = data->cmdq;
+
+	if (q) wait_event_timeout(q->idle, READ_ONCE(q->state) == CMDQ_IDLE, msecs_to_jiffies(ms));
+}
+
+// Queue a device command (any context)
+// done (may be NULL) is called with ctx once the command is over ; it is never called if queueing fails
+// Returns 0, -EBUSY if the queue is full, or -ESHUTDOWN once the queue is closing
+int queue_command (struct drvdata* data, const struct razer_report* req,
+		void (*done) (struct drvdata*, void*, const struct razer_report*, int), void* ctx) {
+	struct cmdqueue* q = data->cmdq;
+	struct command* cmd;
+	unsigned long flags;
+	int status = 0;
+
+	if (!q) return -ENODEV;
+
+	spin_lock_irqsave(&q->lock, flags);
+
+	if (q->dead) status = -ESHUTDOWN;
+	else if (q->len == CMD_SLOTS) {
+		++q->overflow;
+		status = -EBUSY;
+	}
+	else {
+		cmd = &q->cmds[(q->head + q->len++) & (CMD_SLOTS - 1)];
+		cmd->req = *req;
+		cmd->req.cksum = report_checksum(&cmd->req);
+		cmd->done = done;
+		cmd->ctx = ctx;
+		cmd->queued_ns = latency_start();
+
+		if (q->state == CMDQ_IDLE) {
+			q->state = CMDQ_WAIT;
+			q->stage = CMDQ_SEND;
+			if (!q->awake) q->awake = !data->ctrl->get(data);
+			hrtimer_start(&q->timer, 0, HRTIMER_MODE_REL_SOFT);
+		}
+	}
+
+	spin_unlock_irqrestore(&q->lock, flags);
+	return status;
+}
+
+// Send a command and wait for the device response (process context only)
+// out (may be NULL) receives the response
+// Returns 0 or a negative errno
+// NOTE: Every transfer is bounded by the watchdog and every command by CMD_RETRIES, so this always returns
+int send_command (struct drvdata* data, const struct razer_report* req, struct razer_report* out) {
+	struct cmdwait wait = { .out = out };
+	int status;
+
+	init_completion(&wait.done);
+	if ((status = queue_command(data, req, send_command_complete, &wait))) return status;
+
+	wait_for_completion(&wait.done);
+	return wait.status;
+}
+
+void send_command_complete (struct drvdata* data, void* ctx, const struct razer_report* resp, int status) {
+	struct cmdwait* wait = ctx;
+
+	if (resp && wait->out) *wait->out = *resp;
+	wait->status = status;
+	complete(&wait->done);
+}
+
+// Start the pending transfer stage, or cancel the one in flight if the watchdog expired
+enum hrtimer_restart command_timer (struct hrtimer* timer) {
+	struct cmdqueue* q = container_of(timer, struct cmdqueue, timer);
+	struct drvdata* data = q->data;
+	unsigned long flags;
+	u8 state;
+	u8 stage;
+	int status;
+
+	spin_lock_irqsave(&q->lock, flags);
+	state = q->state;
+	stage = q->stage;
+
+	if (state == CMDQ_WAIT) {
+		q->state = CMDQ_BUSY;
+		q->timedout = 0;
+
+		if (stage == CMDQ_SEND) q->context->req = q->cmds[q->head].req;
+		else memset(&q->context->req, 0, sizeof(struct razer_report));
+
+		// NOTE: Armed before the transfer starts, since its completion may rearm the timer
+		hrtimer_start(timer, ms_to_ktime(CMD_TIMEOUT_MS), HRTIMER_MODE_REL_SOFT);
+	}
+	else if (state == CMDQ_BUSY) q->timedout = 1;
+
+	spin_unlock_irqrestore(&q->lock, flags);
+
+	if (state == CMDQ_WAIT && (status = data->ctrl->submit(data, stage))) {
+		// The device is still resuming from autosuspend: try again a little later (or once it has resumed)
+		if (status == -EHOSTUNREACH && retry_command(q)) return HRTIMER_NORESTART;
+		complete_command(data, status);
+	}
+	else if (state == CMDQ_BUSY) data->ctrl->cancel(data);
+
+	return HRTIMER_NORESTART;
+}
+
+// Put the transfer refused by a resuming device back to wait (its watchdog is replaced by the retry delay)
+// Returns nonzero if it will be retried, or 0 once the device took too long to resume
+int retry_command (struct cmdqueue* q) {
+	unsigned long flags;
+	int retry;
+
+	spin_lock_irqsave(&q->lock, flags);
+
+	if ((retry = q->state == CMDQ_BUSY && q->waking < CMD_WAKE_TRIES)) {
+		++q->waking;
+		q->state = CMDQ_WAIT;
+		hrtimer_start(&q->timer, us_to_ktime(CMD_WAKE_US), HRTIMER_MODE_REL_SOFT);
+	}
+
+	spin_unlock_irqrestore(&q->lock, flags);
+	return retry;
+}
+
+// Start the transfer waiting on a resuming device right away (called once it has resumed)
+void kick_command_queue (struct drvdata* data) {
+	struct cmdqueue* q = data->cmdq;
+	unsigned long flags;
+
+	if (!q) return;
+
+	spin_lock_irqsave(&q->lock, flags);
+	if (q->state == CMDQ_WAIT && q->waking) hrtimer_start(&q->timer, 0, HRTIMER_MODE_REL_SOFT);
+	spin_unlock_irqrestore(&q->lock, flags);
+}
+
+// Called by the control backend once a transfer stage is done
+// Moves the current command on to its response (or a busy retry), or finishes it and starts the next one
+void complete_command (struct drvdata* data, int status) {
+	struct cmdqueue* q = data->cmdq;
+	struct razer_report resp;
+	struct command cmd;
+	const struct razer_report* out = NULL;
+	unsigned long flags;
+	u32 delay = 0;
+
+	spin_lock_irqsave(&q->lock, flags);
+
+	if (q->state != CMDQ_BUSY) {
+		spin_unlock_irqrestore(&q->lock, flags);
+		return;
+	}
+
+	if (status == -ECONNRESET && q->timedout) status = -ETIMEDOUT;
+	q->waking = 0;
+
+	if (!status && q->stage == CMDQ_SEND) {
+		q->stage = CMDQ_READ;
+		delay = CMD_DELAY_US;
+	}
+	else if (!status) {
+		resp = q->context->req;
+		status = command_status(&q->cmds[q->head].req, &resp);
+
+		// Still working on it (or an older response): read again a little later
+		if (status == -EBUSY && q->retries < CMD_RETRIES) delay = CMD_DELAY_US << ++q->retries;
+		else out = &resp;
+	}
+
+	if (delay) {
+		q->state = CMDQ_WAIT;
+		hrtimer_start(&q->timer, us_to_ktime(delay), HRTIMER_MODE_REL_SOFT);
+		spin_unlock_irqrestore(&q->lock, flags);
+		return;
+	}
+
+	// The command is over: release its slot before the callback so that it can queue another
+	cmd = q->cmds[q->head];
+	record_command(q, &cmd, status);
+	trace_tartarus_command(cmd.req.class, cmd.req.cmd_id.id, cmd.req.tr_id.id, q->retries, status);
+
+	q->head = (q->head + 1) & (CMD_SLOTS - 1);
+	--q->len;
+	q->retries = 0;
+
+	if (q->len && !q->dead) {
+		q->state = CMDQ_WAIT;
+		q->stage = CMDQ_SEND;
+		hrtimer_start(&q->timer, 0, HRTIMER_MODE_REL_SOFT);
+	}
+	else {
+		q->state = CMDQ_IDLE;
+		hrtimer_try_to_cancel(&q->timer);		// (Watchdog)
+		wake_up(&q->idle);
+
+		if (q->awake) data->ctrl->put(data);
+		q->awake = 0;
+	}
+
+	spin_unlock_irqrestore(&q->lock, flags);
+
+	latency_record(data, LAT_CMD, cmd.queued_ns);
+
+	// Killed URBs are expected on disconnect
+	if (status && status != -ENOENT && status != -EPERM && status != -ESHUTDOWN)
+		printk(KERN_WARNING "HID Tartarus: Device command 0x%02x:0x%02x failed (status: %d)\n", cmd.req.class, cmd.req.cmd_id.id, status);
+
+	if (cmd.done) cmd.done(data, cmd.ctx, out, status);
+}
+
+// Check a device response against its request
+// Every command goes out with the same transaction ID, so a response is matched on its class and command only
+// Returns 0, -EBUSY (busy, or the response to another command), or the errno of a failure status
+int command_status (const struct razer_report* req, const struct razer_report* resp) {
+	if (resp->class != req->class || resp->cmd_id.parts.id != req->cmd_id.parts.id)
+		return -EBUSY;
+
+	switch (resp->status) {
+	case STATUS_OK:				return 0;
+	case STATUS_NEW:
+	case STATUS_BUSY:			return -EBUSY;
+	case STATUS_TIMEOUT:		return -ETIMEDOUT;
+	case STATUS_UNSUPPORTED:	return -EOPNOTSUPP;
+	default:					return -EIO;
+	}
+}
+
+// Account a finished command to its statistics entry (the last entry takes any command beyond CMD_STATS)
+// NOTE: q->lock must be held
+void record_command (struct cmdqueue* q, const struct command* cmd, int status) {
+	struct cmdstats* stats = q->stats;
+	u64 delta = ktime_get_ns() - cmd->queued_ns;
+
+	for (; stats < q->stats + CMD_STATS - 1 && stats->count; ++stats)
+		if (stats->class == cmd->req.class && stats->id == cmd->req.cmd_id.id) break;
+
+	if (!stats->count) {
+		stats->class = cmd->req.class;
+		stats->id = cmd->req.cmd_id.id;
+	}
+
+	++stats->count;
+	stats->busy += q->retries;
+	if (status) ++stats->failed;
+	stats->total_ns += delta;
+	if (delta > stats->max_ns) stats->max_ns = delta;
+}
+
+// Prepare the profile LED pipeline
+// LED commands go through the command queue, so this only tracks the LED state
+int init_profile_led (struct drvdata* data) {
+	struct ledctl* leds;
+
+	leds = kzalloc(sizeof(struct ledctl), GFP_KERNEL);
+	if (!leds) return -ENOMEM;
+
+	spin_lock_init(&leds->lock);
+	data->leds = leds;
+
+	return 0;
+}
+
+// Release the profile LED pipeline
+// NOTE: Must not race with set_profile() (i.e. call once the device is stopped) ; free the command queue first
+void free_profile_led (struct drvdata* data) {
+	struct ledctl* leds = data->leds;
+	if (!leds) return;
+
+	data->leds = NULL;
+	kfree(leds);
+}
+
+// Request a profile LED state (bits R: 0x04, G: 0x02, B: 0x01)
+// Never blocks: a request made while a command is queued is picked up when that command completes
+void set_profile_led (struct drvdata* data, u8 state) {
+	struct ledctl* leds = data->leds;
+	unsigned long flags;
+	int submit;
+	u8 next;
+
+	state &= LED_MASK;
+	spin_lock_irqsave(&leds->lock, flags);
+
+	// Coalesced -> The request replaces an earlier one which still had LEDs waiting for the command in flight
+	// (Repeats of the requested state, and requests the device already shows, save nothing)
+	if (leds->inflight && state != leds->desired) {
+		next = leds->req.data[2] ? (leds->shown | leds->inflight) : (leds->shown & ~leds->inflight);
+		if (((leds->desired ^ next) | ~(leds->known | leds->inflight)) & LED_MASK) ++leds->coalesced;
+	}
+
+	leds->desired = state;
+	submit = next_profile_led(leds);
+	spin_unlock_irqrestore(&leds->lock, flags);
+
+	if (submit) submit_profile_led(data);
+}
+
+// Forget what the device shows and send the requested LED state again (i.e. the device lost power)
+// Coalesces with any request made in the meantime, like set_profile_led()
+void resync_profile_led (struct drvdata* data) {
+	struct ledctl* leds = data->leds;
+	unsigned long flags;
+	int submit;
+
+	spin_lock_irqsave(&leds->lock, flags);
+	leds->known = 0;
+	submit = next_profile_led(leds);
+	spin_unlock_irqrestore(&leds->lock, flags);
+
+	if (submit) submit_profile_led(data);
+}
+
+// Prepare the command for the next LED which differs from the requested state
+// Returns nonzero if the caller should submit it (after releasing the lock)
+// NOTE: leds->lock must be held
+int next_profile_led (struct ledctl* leds) {
+	struct razer_report* req = &leds->req;
+	u8 diff;
+	u8 bit;
+
+	if (leds->inflight) return 0;
+
+	diff = ((leds->desired ^ leds->shown) | ~leds->known) & LED_MASK;
+	if (!diff) return 0;
+
+	bit = diff & (~diff + 1);	// Lowest differing LED
+
+	*req = init_report(CMD_SET_LED);
+	req->data[0] = 0x00;		// TODO: Can be 0 or 1, but unsure what this param does (variable store?)
+	req->data[1] = LED_BLUE - (ffs(bit) - 1);		// BLUE -> 0x0E ; GREEN -> 0x0D ; RED -> 0x0C
+	req->data[2] = !!(leds->desired & bit);
+
+	leds->inflight = bit;
+	++leds->submitted;
+
+	trace_tartarus_led_submit(req->data[1], req->data[2]);
+	return 1;
+}
+
+// Hand the prepared command to the command queue
+void submit_profile_led (struct drvdata* data) {
+	int status;
+
+	if ((status = queue_command(data, &data->leds->req, set_profile_led_complete, NULL)))
+		set_profile_led_complete(data, NULL, NULL, status);
+}
+
+// Called by the command queue once the LED command is over
+// Chains the next command if the requested state has moved on in the meantime
+void set_profile_led_complete (struct drvdata* data, void* ctx, const struct razer_report* resp, int status) {
+	struct ledctl* leds = data->leds;
+	unsigned long flags;
+	int submit = 0;
+	u8 bit;
+
+	spin_lock_irqsave(&leds->lock, flags);
+	bit = leds->inflight;
+	leds->inflight = 0;
+	trace_tartarus_led_complete(leds->req.data[1], status);
+
+	// On failure, stop here: the next request will retry whatever is still out of date
+	if (status) ++leds->failed;
+	else {
+		leds->known |= bit;
+		leds->shown = leds->req.data[2] ? (leds->shown | bit) : (leds->shown & ~bit);
+		submit = next_profile_led(leds);
+	}
+
+	spin_unlock_irqrestore(&leds->lock, flags);
+
+	if (submit) submit_profile_led(data);
+}
+
+// Control backend (USB)
+// Preallocates the control URB of the command queue
+int ctrl_usb_open (struct drvdata* data) {
+	struct cmdqueue* q = data->cmdq;
+
+	q->urb = usb_alloc_urb(0, GFP_KERNEL);
+	return q->urb ? 0 : -ENOMEM;
+}
+
+// Start a transfer stage (asynchronous)
+//  CMDQ_SEND: 0x09 --> HID_REQ_SET_REPORT ; 0x21 --> USB_TYPE_CLASS | USB_RECIP_INTERFACE | USB_DIR_OUT
+//  CMDQ_READ: 0x01 --> HID_REQ_GET_REPORT ; 0xA1 --> USB_TYPE_CLASS | USB_RECIP_INTERFACE | USB_DIR_IN
+int ctrl_usb_submit (struct drvdata* data, u8 stage) {
+	struct usb_device* usbdev = data->parent;
+	struct cmdqueue* q = data->cmdq;
+	struct usb_ctrlrequest* setup = &q->context->setup;
+
+	setup->bRequestType = (stage == CMDQ_SEND) ? 0x21 : 0xA1;
+	setup->bRequest = (stage == CMDQ_SEND) ? 0x09 : 0x01;
+	setup->wValue = cpu_to_le16(0x300);
+	setup->wIndex = cpu_to_le16(0x01);
+	setup->wLength = cpu_to_le16(REPORT_LEN);
+
+	usb_fill_control_urb(q->urb, usbdev, (stage == CMDQ_SEND) ? usb_sndctrlpipe(usbdev, 0) : usb_rcvctrlpipe(usbdev, 0),
+		(unsigned char*) setup, &q->context->req, REPORT_LEN, ctrl_usb_complete, data);
+
+	return usb_submit_urb(q->urb, GFP_ATOMIC);
+}
+
+// The URB completes with -ECONNRESET (see complete_command())
+void ctrl_usb_cancel (struct drvdata* data) {
+	usb_unlink_urb(data->cmdq->urb);
+}
+
+// NOTE: Poisoning waits for the URB in flight and makes any later submission fail (the URB is freed with the queue)
+void ctrl_usb_close (struct drvdata* data) {
+	usb_poison_urb(data->cmdq->urb);
+}
+
+void ctrl_usb_complete (struct urb* ctrl) {
+	// A short response is as good as none
+	int status = (!ctrl->status && ctrl->actual_length != REPORT_LEN) ? -EIO : ctrl->status;
+	complete_command(ctrl->context, status);
+}
+
+// The resume is only requested here: transfers refused until it is done are retried (see retry_command())
+// NOTE: Fails (holding nothing) if runtime power management is disabled, in which case the device never sleeps anyway
+int ctrl_usb_get (struct drvdata* data) {
+	return usb_autopm_get_interface_async(to_usb_interface(data->dev->parent));
+}
+
+void ctrl_usb_put (struct drvdata* data) {
+	usb_autopm_put_interface_async(to_usb_interface(data->dev->parent));
+}
+
+// Control backend (stub)
+// Virtual devices have no control channel, so commands are only logged and answered with success right away
+int ctrl_stub_open (struct drvdata* data) { return 0; }
+void ctrl_stub_cancel (struct drvdata* data) { }
+void ctrl_stub_close (struct drvdata* data) { }
+int ctrl_stub_get (struct drvdata* data) { return 0; }
+void ctrl_stub_put (struct drvdata* data) { }
+
+int ctrl_stub_submit (struct drvdata* data, u8 stage) {
+	struct razer_report* report = &data->cmdq->context->req;
+
+	if (stage == CMDQ_SEND) {
+		printk(KERN_DEBUG "HID Tartarus: (stub) Control command  Class: 0x%02x  Command ID: 0x%02x  Data: %02x %02x %02x\n",
+			report->class, report->cmd_id.id, report->data[0], report->data[1], report->data[2]);
+	}
+	else {
+		// Echo the request as the response
+		*report = data->cmdq->cmds[data->cmdq->head].req;
+		report->status = STATUS_OK;
+	}
+
+	complete_command(data, 0);
+	return 0;
+}
@@ -17,152 +17,87 @@
 	 (HS)    0x4B    0x48    0x4D    0x50
 /*/
 
-const char debug_keymap [0x200] = {
-	//   0 (0x00)
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x01, 0x1E,  0x00, 0x00,  0x01, 0x2E,  0x01, 0x20,  
-	0x01, 0x12,  0x01, 0x21,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x01, 0x10,  0x01, 0x13,  0x01, 0x1F,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x01, 0x11,  0x01, 0x2D,  0x00, 0x00,  0x01, 0x2C,  0x03, 0x01,  0x03, 0x02,  
-
-	//  32 (0x20)
-	0x03, 0x03,  0x03, 0x04,  0x03, 0x05,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x01, 0x01,  0x01, 0x39,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x01, 0x2B,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-
-	//  64 (0x40)
-	0x00, 0x00,  0x00, 0x00,  0x01, 0x2A,  0x00, 0x00,  0x02, 0x02,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x01, 0x4D,  
-	0x01, 0x4B,  0x01, 0x50,  0x01, 0x48,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,
-
-	//  96 (0x60)
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-
-	// 128 (0x80)
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-
-	// 160 (0xA0)
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-
-	// 192 (0xC0)
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-
-	// 224 (0xE0)
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
+// Indexed by raw key like struct profile ; keys not listed are CTRL_NOP
+const struct bind debug_keymap [KEYMAP_LEN] = {
+	[0x04] = { CTRL_KEY, 0, 0x1E },
+	[0x06] = { CTRL_KEY, 0, 0x2E },
+	[0x07] = { CTRL_KEY, 0, 0x20 },
+	[0x08] = { CTRL_KEY, 0, 0x12 },
+	[0x09] = { CTRL_KEY, 0, 0x21 },
+	[0x14] = { CTRL_KEY, 0, 0x10 },
+	[0x15] = { CTRL_KEY, 0, 0x13 },
+	[0x16] = { CTRL_KEY, 0, 0x1F },
+	[0x1A] = { CTRL_KEY, 0, 0x11 },
+	[0x1B] = { CTRL_KEY, 0, 0x2D },
+	[0x1D] = { CTRL_KEY, 0, 0x2C },
+	[0x1E] = { CTRL_PROFILE, 0, 0x01 },
+	[0x1F] = { CTRL_PROFILE, 0, 0x02 },
+	[0x20] = { CTRL_PROFILE, 0, 0x03 },
+	[0x21] = { CTRL_PROFILE, 0, 0x04 },
+	[0x22] = { CTRL_PROFILE, 0, 0x05 },
+	[0x2B] = { CTRL_KEY, 0, 0x01 },
+	[0x2C] = { CTRL_KEY, 0, 0x39 },
+	[0x39] = { CTRL_KEY, 0, 0x2B },
+	[0x42] = { CTRL_KEY, 0, 0x2A },
+	[0x44] = { CTRL_SHIFT, 0, 0x02 },
+	[0x4F] = { CTRL_KEY, 0, 0x4D },
+	[0x50] = { CTRL_KEY, 0, 0x4B },
+	[0x51] = { CTRL_KEY, 0, 0x50 },
+	[0x52] = { CTRL_KEY, 0, 0x48 },
 };
 
-const char base_keymap [0x200] = {
-	//   0 (0x00)
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x01, 0x1E,  0x00, 0x00,  0x01, 0x2E,  0x01, 0x20,  
-	0x01, 0x12,  0x01, 0x21,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x01, 0x10,  0x01, 0x13,  0x01, 0x1F,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x01, 0x11,  0x01, 0x2D,  0x00, 0x00,  0x01, 0x2C,  0x01, 0x02,  0x01, 0x03,  
-
-	//  32 (0x20)
-	0x01, 0x04,  0x01, 0x05,  0x01, 0x06,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x01, 0x01,  0x01, 0x39,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x01, 0x2B,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-
-	//  64 (0x40)
-	0x00, 0x00,  0x00, 0x00,  0x01, 0x2A,  0x00, 0x00,  0x02, 0x03,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x01, 0x4D,  
-	0x01, 0x4B,  0x01, 0x50,  0x01, 0x48,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,
-
-	//  96 (0x60)
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-
-	// 128 (0x80)
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-
-	// 160 (0xA0)
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-
-	// 192 (0xC0)
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-
-	// 224 (0xE0)
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
+const struct bind base_keymap [KEYMAP_LEN] = {
+	[0x04] = { CTRL_KEY, 0, 0x1E },
+	[0x06] = { CTRL_KEY, 0, 0x2E },
+	[0x07] = { CTRL_KEY, 0, 0x20 },
+	[0x08] = { CTRL_KEY, 0, 0x12 },
+	[0x09] = { CTRL_KEY, 0, 0x21 },
+	[0x14] = { CTRL_KEY, 0, 0x10 },
+	[0x15] = { CTRL_KEY, 0, 0x13 },
+	[0x16] = { CTRL_KEY, 0, 0x1F },
+	[0x1A] = { CTRL_KEY, 0, 0x11 },
+	[0x1B] = { CTRL_KEY, 0, 0x2D },
+	[0x1D] = { CTRL_KEY, 0, 0x2C },
+	[0x1E] = { CTRL_KEY, 0, 0x02 },
+	[0x1F] = { CTRL_KEY, 0, 0x03 },
+	[0x20] = { CTRL_KEY, 0, 0x04 },
+	[0x21] = { CTRL_KEY, 0, 0x05 },
+	[0x22] = { CTRL_KEY, 0, 0x06 },
+	[0x2B] = { CTRL_KEY, 0, 0x01 },
+	[0x2C] = { CTRL_KEY, 0, 0x39 },
+	[0x39] = { CTRL_KEY, 0, 0x2B },
+	[0x42] = { CTRL_KEY, 0, 0x2A },
+	[0x44] = { CTRL_SHIFT, 0, 0x03 },
+	[0x4F] = { CTRL_KEY, 0, 0x4D },
+	[0x50] = { CTRL_KEY, 0, 0x4B },
+	[0x51] = { CTRL_KEY, 0, 0x50 },
+	[0x52] = { CTRL_KEY, 0, 0x48 },
 };
 
-const char shift_keymap [0x200] = {
-	//   0 (0x00)
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x01, 0x1E,  0x00, 0x00,  0x01, 0x2E,  0x01, 0x20,  
-	0x01, 0x12,  0x01, 0x21,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x01, 0x10,  0x01, 0x13,  0x01, 0x1F,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x01, 0x11,  0x01, 0x2D,  0x00, 0x00,  0x01, 0x2C,  0x01, 0x07,  0x01, 0x08,  
-
-	//  32 (0x20)
-	0x01, 0x09,  0x01, 0x0A,  0x01, 0x0B,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x01, 0x01,  0x01, 0x39,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x01, 0x2B,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-
-	//  64 (0x40)
-	0x00, 0x00,  0x00, 0x00,  0x01, 0x2A,  0x00, 0x00,  0x02, 0x02,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x01, 0x4D,  
-	0x01, 0x4B,  0x01, 0x50,  0x01, 0x48,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,
-
-	//  96 (0x60)
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-
-	// 128 (0x80)
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-
-	// 160 (0xA0)
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-
-	// 192 (0xC0)
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-
-	// 224 (0xE0)
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
-	0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  0x00, 0x00,  
+const struct bind shift_keymap [KEYMAP_LEN] = {
+	[0x04] = { CTRL_KEY, 0, 0x1E },
+	[0x06] = { CTRL_KEY, 0, 0x2E },
+	[0x07] = { CTRL_KEY, 0, 0x20 },
+	[0x08] = { CTRL_KEY, 0, 0x12 },
+	[0x09] = { CTRL_KEY, 0, 0x21 },
+	[0x14] = { CTRL_KEY, 0, 0x10 },
+	[0x15] = { CTRL_KEY, 0, 0x13 },
+	[0x16] = { CTRL_KEY, 0, 0x1F },
+	[0x1A] = { CTRL_KEY, 0, 0x11 },
+	[0x1B] = { CTRL_KEY, 0, 0x2D },
+	[0x1D] = { CTRL_KEY, 0, 0x2C },
+	[0x1E] = { CTRL_KEY, 0, 0x07 },
+	[0x1F] = { CTRL_KEY, 0, 0x08 },
+	[0x20] = { CTRL_KEY, 0, 0x09 },
+	[0x21] = { CTRL_KEY, 0, 0x0A },
+	[0x22] = { CTRL_KEY, 0, 0x0B },
+	[0x2B] = { CTRL_KEY, 0, 0x01 },
+	[0x2C] = { CTRL_KEY, 0, 0x39 },
+	[0x39] = { CTRL_KEY, 0, 0x2B },
+	[0x42] = { CTRL_KEY, 0, 0x2A },
+	[0x44] = { CTRL_SHIFT, 0, 0x02 },
+	[0x4F] = { CTRL_KEY, 0, 0x4D },
+	[0x50] = { CTRL_KEY, 0, 0x4B },
+	[0x51] = { CTRL_KEY, 0, 0x50 },
+	[0x52] = { CTRL_KEY, 0, 0x48 },
 };
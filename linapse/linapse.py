@@ -1,5 +1,10 @@
+import collections
 import io
+import mmap
 import os
+import select
+import struct
+import subprocess
 import sys
 
 from functools import partial
@@ -25,9 +30,17 @@ class Bind:
             case 4: return "MACRO"
             case 5: return "SCRIPT"
             case 6: return "SWKEY"
+            case 9: return "TRANS" if shorten else "TRANSPARENT"
             case 255: return "DEBUG"
             case _: return "UNDEF" if shorten else "UNDEFINED"
 
+    # Modifiers a key bind holds along with its key (BMOD_* in translate.h)
+    _modcodes = {
+        "CTRL": 0x01, "LCTRL": 0x01, "SHIFT": 0x02, "LSHIFT": 0x02, "ALT": 0x04, "LALT": 0x04, "META": 0x08, "SUPER": 0x08, "LMETA": 0x08,
+        "RCTRL": 0x10, "RSHIFT": 0x20, "RALT": 0x40, "RMETA": 0x80, "RSUPER": 0x80
+    }
+    _modnames = ["CTRL", "SHIFT", "ALT", "META", "RCTRL", "RSHIFT", "RALT", "RMETA"]
+
     # We don't automatically perform this in initalization since self._data can be reassigned by the UI
     def parseDataStr(self):
         # No conversion if our data is already processed
@@ -35,6 +48,7 @@ class Bind:
         
         comp = self._data
         self._data = 0
+        self._mods = 0
 
         # Unset data if no keybind
         if comp is None or len(comp) == 0: return True
@@ -51,6 +65,13 @@ class Bind:
             if len(comp) > 1:
                 splits = comp.split(' ')
                 comp = "".join(splits)
+
+            # Combos: modifiers in front of the key (EX: CTRL+SHIFT+T)
+            while "+" in comp[:-1]:
+                mod, rest = comp.split("+", 1)
+                if mod not in Bind._modcodes: break
+                self._mods |= Bind._modcodes[mod]
+                comp = rest
             
             try: idx = Profile._names[comp]
             except KeyError: pass
@@ -77,7 +98,7 @@ class Bind:
         
         # Range checks
         if comp < 1: return False
-        if self._type == 1 and comp >= len(Profile._codes): return False
+        if self._type == 1 and comp > KEY_MAX_: return False
         elif self._type == 4 and comp >= len(Profile._mcodes): return False
 
         self._data = comp
@@ -91,10 +112,10 @@ class Bind:
             case 1:
                 ret = None
                 try: ret = Profile._codes[self._data]
-                except IndexError: return "UNSUPPORTED"
+                except IndexError: ret = hex(self._data)
                 
                 if ret is None: return "UNSUPPORTED"
-                return ret
+                return "".join(name + "+" for bit, name in enumerate(Bind._modnames) if self._mods & (1 << bit)) + ret
             case 2: return str(self._data)
             case 3: return str(self._data)
             case 4: 
@@ -106,23 +127,28 @@ class Bind:
                 return ret
             case _: return str(self._data)  # TODO
     
-    def __init__(self, _type, _data):
+    def __init__(self, _type, _data, _mods = 0):
         self._type = _type if type(_type) is int else int(_type, 0)
         self._data = _data  #ord(_data)
+        self._mods = _mods
 
     def __str__(self):
         ret = Bind.printTypeString(self._type)
         ret += " : "
         ret += f"'{self._data}'" if type(self._data) is str else hex(self._data)
+        if self._mods: ret += f" (mods {hex(self._mods)})"
 
         return ret
 
     def __eq__(self, other):
-        if self._type == other._type and self._data == other._data: return True
+        if self._type == other._type and self._data == other._data and self._mods == other._mods: return True
         return False
 
+KEY_MAX_ = 0x2FF    # Highest keycode (input-event-codes.h)
+
 class Profile:
-    _size = 512     # Update upon modification of profile format
+    _size = 1024    # Update upon modification of profile format
+    _bind = "<BBH"  # struct bind: type, mods, data (native byte order in the driver)
     _keys = [
         0x1E, 0x1F, 0x20, 0x21, 0x22,
         0x2B, 0x14, 0x1A, 0x08, 0x15,
@@ -289,13 +315,9 @@ class Profile:
     def load(self, buf, size = 0):
         self.keymap = []
         
-        i = 0
-        while (i < Profile._size):
-            btype = buf[i] if i < size else 0
-            bdata = buf[i + 1] if (i + 1) < size else 0
-                        
-            self.keymap.append(Bind(btype, bdata))
-            i += 2
+        buf = bytes(buf[:size]).ljust(Profile._size, b"\0")
+        for btype, bmods, bdata in struct.iter_unpack(Profile._bind, buf[:Profile._size]):
+            self.keymap.append(Bind(btype, bdata, bmods))
 
     # Returns the buffer to store; does not perform the storing itself
     def store(self):
@@ -304,19 +326,17 @@ class Profile:
         i = 0
         buf = bytearray(Profile._size)
         for bind in self.keymap:
-            if (i + 1) >= Profile._size: break
+            if i >= Profile._size: break
             
-            buf[i] = bind._type
-            buf[i + 1] = bind._data
-
-            i += 2
+            struct.pack_into(Profile._bind, buf, i, bind._type, bind._mods, bind._data)
+            i += 4
 
         return buf, i
 
     # This will need to be updated if more fields are added to profiles
     def __repr__(self):
         length = len(getattr(self, "keymap", []))
-        return f"<Profile : {length * 2} bytes>"
+        return f"<Profile : {length * 4} bytes>"
 
     def __str__(self):
         if len(getattr(self, "keymap", [])) <= 0:
@@ -344,12 +364,8 @@ class Profile:
                 key = Profile._keys[key_idx + j]
                 btype = self.keymap[key]._type
                 bdata = self.keymap[key]._data
-
-                code = "<OOB>"
-                try: code = Profile._codes[bdata]
-                except IndexError: pass
                 
-                if (btype == 1): ret += f"┃ {code}\t┃\t"
+                if (btype == 1): ret += f"┃ {self.keymap[key].printDataStr()}\t┃\t"
                 else: ret += f"┃ {hex(bdata)}\t┃\t"
 
             # Row 4 -> pretty formatting
@@ -497,7 +513,7 @@ class Editor:
         
         keyidx = Profile._keys[key]
         oldbind = self.profile.keymap[keyidx]
-        newbind = Bind(oldbind._type, oldbind._data)
+        newbind = Bind(oldbind._type, oldbind._data, oldbind._mods)
 
         bindWindow = tk.Toplevel(self.rootWindow)
         bindWindow.title(f"Edit Key {'0' if key < 9 else ''}{key + 1}")
@@ -637,6 +653,7 @@ class Editor:
     def _cancelKeyChange(self, window, oldbind, newbind, event):
         newbind._type = oldbind._type
         newbind._data = oldbind._data
+        newbind._mods = oldbind._mods
         window.destroy()
 
     def _saveActiveProfile(self):
@@ -795,6 +812,263 @@ def load_profile(path: str):
     if size > 0: return True
     return False
 
+# Load a full configuration (one profile file per device profile) in a single write
+# Profiles are assigned in order starting at profile 1 ; the device holds exactly these profiles afterwards
+MAXCONFIG_ = 255    # PROFILE_MAX in translate.h
+
+def build_config(paths: list):
+    if len(paths) > MAXCONFIG_:
+        print(f"Warning: Only the first {MAXCONFIG_} profiles will be loaded")
+        paths = paths[:MAXCONFIG_]
+
+    profiles = []
+    for path in paths:
+        profile = bytearray(Profile._size)
+        try:
+            with io.open(path, "rb") as infile:
+                infile.readinto(profile)
+
+        except FileNotFoundError:
+            print(f"Failed to load profile '{path}'")
+            return None
+
+        profiles.append(profile)
+
+    # The driver stores every profile as its differences from the base profile,
+    # so share the one which differs the least from all the others
+    keys = range(0, Profile._size, 4)
+    shared = [collections.Counter(bytes(profile[k:k + 4]) for profile in profiles) for k in keys]
+    base = max(range(len(profiles)), key = lambda i: sum(shared[n][bytes(profiles[i][k:k + 4])] for n, k in enumerate(keys)), default = -1)
+
+    # Header (see struct config in module.h): major, minor, profiles, macros, base, unused
+    buf = bytearray([2, 0, len(profiles), 0, base + 1, 0, 0, 0])
+    for profile in profiles: buf += profile
+    return buf
+
+def load_config(paths: list):
+    buf = build_config(paths)
+    if buf is None: return False
+
+    size = write_device_file(buf, "config")
+    if size == len(buf): return True
+    return False
+
+# Sample the shared state page (see struct statepage in module.h) without any further syscalls
+# Returns (profile, shift, revert, reports, events, held keys) or None
+STATE_FORMAT_ = "<IBBBBII32s"
+
+def read_state(ipath = None):
+    if ipath is None: ipath = KBDPATH_
+    path = DRIVERPATH_ + ipath + "/state"
+
+    try:
+        with io.open(path, "rb") as sysfile:
+            page = mmap.mmap(sysfile.fileno(), mmap.PAGESIZE, prot = mmap.PROT_READ)
+
+    except FileNotFoundError:
+        print("Could not find device file. Is the the device plugged in?")
+        return None
+
+    # Retry while the driver is mid-update (odd seq) or updated it under us
+    while True:
+        seq, _, profile, shift, revert, reports, events, keys = struct.unpack_from(STATE_FORMAT_, page)
+        if seq % 2 == 0 and struct.unpack_from("<I", page)[0] == seq: break
+
+    page.close()
+    held = [i for i in range(256) if keys[i // 8] & (1 << (i % 8))]
+    return profile, shift, revert, reports, events, held
+
+# Block until the active profile changes (the driver notifies pollers of profile_num)
+# Prints every new profile number until interrupted
+def watch_profile(ipath = None):
+    if ipath is None: ipath = KBDPATH_
+    path = DRIVERPATH_ + ipath + "/profile_num"
+
+    try:
+        with io.open(path, "rb", buffering = 0) as sysfile:
+            poller = select.poll()
+            poller.register(sysfile, select.POLLPRI | select.POLLERR)
+
+            while True:
+                # sysfs requires reading the file (from the start) to rearm the notification
+                sysfile.seek(0)
+                print("> Active profile: " + sysfile.read().decode("utf-8").strip(), flush = True)
+                poller.poll()
+
+    except FileNotFoundError:
+        print("Could not find device file. Is the the device plugged in?")
+
+    except KeyboardInterrupt: pass
+
+# Assemble and upload macros (played back by the driver itself)
+# One macro per line: `<index>: <op> [arg], <op> [arg], ...` ('#' starts a comment)
+# Ops: down <key>, up <key>, delay <ms>, loop <count> (0 -> while held), next
+# EX: `0: down 30, delay 20, up 30` taps KEY_A on a CTRL_MACRO bind with data 0
+MACRO_OPS_ = { "end": 0x00, "down": 0x01, "up": 0x02, "delay": 0x03, "loop": 0x04, "next": 0x05 }
+MACRO_COUNT_ = 32       # MACRO_COUNT in translate.h
+MACRO_KEY_MAX_ = 248    # MOP_KEY_MAX in translate.h (macro keycodes are a single byte)
+
+def build_macros(path: str):
+    macros = [bytearray() for _ in range(MACRO_COUNT_)]
+
+    try:
+        with io.open(path, "r") as infile:
+            for line in infile:
+                line = line.split("#", 1)[0].strip()
+                if len(line) == 0: continue
+
+                idx, ops = line.split(":", 1)
+                code = macros[int(idx, 0)]
+                for op in ops.split(","):
+                    op = op.split()
+                    code.append(MACRO_OPS_[op[0]])
+                    match op[0]:
+                        case "down" | "up":
+                            key = int(op[1], 0)
+                            if not 0 < key <= MACRO_KEY_MAX_:
+                                raise ValueError(f"macro {idx}: key {key} is out of range, macros send keycodes 1 - {MACRO_KEY_MAX_} (bind higher keys directly)")
+                            code.append(key)
+
+                        case "loop":
+                            count = int(op[1], 0)
+                            if not 0 <= count <= 0xFF: raise ValueError(f"macro {idx}: loop count {count} is out of range (0 - 255)")
+                            code.append(count)
+
+                        case "delay":
+                            delay = int(op[1], 0)
+                            if not 0 <= delay <= 0xFFFF: raise ValueError(f"macro {idx}: delay {delay} is out of range (0 - 65535 ms)")
+                            code += delay.to_bytes(2, "little")
+
+                code.append(MACRO_OPS_["end"])
+
+    except (FileNotFoundError, ValueError, KeyError, IndexError) as err:
+        print(f"Failed to load macros '{path}' ({err})")
+        return None
+
+    # Header (see struct macrocfg in module.h): major, minor, code length, size of every macro
+    code = b"".join(macros)
+    buf = bytearray([1, 0]) + len(code).to_bytes(2, "little")
+    for macro in macros: buf += len(macro).to_bytes(2, "little")
+    buf += code
+    return buf
+
+def load_macros(path: str):
+    buf = build_macros(path)
+    if buf is None: return False
+
+    size = write_device_file(buf, "macros")
+    if size == len(buf): return True
+    return False
+
+# Write a profile pack: the config followed by the macros (if any), exactly as they would be uploaded
+# The driver loads it through the firmware loader when a pad is first seen (module parameter profile_pack)
+# EX: `linapse.py -P /lib/firmware/tartarus-profiles.bin -C base.bin shift.bin -M macros.txt`
+def save_pack(path: str, paths: list, macros = None):
+    buf = build_config(paths)
+    if buf is None: return False
+
+    if macros:
+        code = build_macros(macros)
+        if code is None: return False
+        buf += code
+
+    try:
+        with io.open(path, "wb") as outfile:
+            outfile.write(buf)
+
+    except OSError as err:
+        print(f"Failed to write profile pack '{path}' ({err})")
+        return False
+
+    return True
+
+# HID usage -> Linux keycode (hid_keyboard in drivers/hid/hid-input.c) ; 0 -> No keycode
+HID_KEYBOARD_ = [
+      0,  0,  0,  0, 30, 48, 46, 32, 18, 33, 34, 35, 23, 36, 37, 38,
+     50, 49, 24, 25, 16, 19, 31, 20, 22, 47, 17, 45, 21, 44,  2,  3,
+      4,  5,  6,  7,  8,  9, 10, 11, 28,  1, 14, 15, 57, 12, 13, 26,
+     27, 43, 43, 39, 40, 41, 51, 52, 53, 58, 59, 60, 61, 62, 63, 64,
+     65, 66, 67, 68, 87, 88, 99, 70,119,110,102,104,111,107,109,106,
+    105,108,103, 69, 98, 55, 74, 78, 96, 79, 80, 81, 75, 76, 77, 71,
+     72, 73, 82, 83, 86,127,116,117,183,184,185,186,187,188,189,190,
+    191,192,193,194,134,138,130,132,128,129,131,137,133,135,136,113,
+    115,114,  0,  0,  0,121,  0, 89, 93,124, 92, 94, 95,  0,  0,  0,
+    122,123, 90, 91, 85,  0,  0,  0,  0,  0,  0,  0,111,  0,  0,  0,
+      0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+      0,  0,  0,  0,  0,  0,179,180,  0,  0,  0,  0,  0,  0,  0,  0,
+      0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+      0,  0,  0,  0,  0,  0,  0,  0,111,  0,  0,  0,  0,  0,  0,  0,
+     29, 42, 56,125, 97, 54,100,126,164,166,165,163,161,115,114,113,
+    150,158,159,128,136,177,178,176,142,152,173,140,  0,  0,  0,  0
+]
+
+# Linux keycode -> HID usage (first usage wins)
+HID_USAGE_ = {}
+for usage, code in enumerate(HID_KEYBOARD_):
+    if code and code not in HID_USAGE_: HID_USAGE_[code] = usage
+
+BPF_KEYMAPS_ = "/sys/fs/bpf/tartarus_keymaps"
+BPF_STATE_ = "/sys/fs/bpf/tartarus_state"
+BPF_PROFILES_ = 8       # BPF_PROFILES in bpf/tartarus.bpf.c (entries of its keymaps map)
+
+# Compile a profile for the HID-BPF backend (see struct bpf_profile in bpf/tartarus.bpf.c)
+# Only key and profile binds can be expressed there (no combos) ; returns the table and the keys which need the kernel module
+def compile_bpf(buf):
+    usage = bytearray(256)
+    jump = bytearray(256)
+    unsupported = []
+
+    for key in range(256):
+        btype, bmods, bdata = struct.unpack_from(Profile._bind, buf, 4 * key)
+        match btype:
+            case 0: pass
+            case 1:
+                if bmods == 0 and bdata in HID_USAGE_: usage[key] = HID_USAGE_[bdata]
+                else: unsupported.append(key)
+            case 3:
+                if 0 < bdata <= BPF_PROFILES_: jump[key] = bdata
+                else: unsupported.append(key)
+            case _: unsupported.append(key)
+
+    return usage + jump, unsupported
+
+# Load a set of profiles (profiles 1, 2, ...) into the HID-BPF backend's pinned maps
+def load_bpf(paths: list):
+    if len(paths) > BPF_PROFILES_:
+        print(f"Warning: The HID-BPF backend holds {BPF_PROFILES_} profiles, ignoring " + " ".join(paths[BPF_PROFILES_:]))
+
+    for idx, path in enumerate(paths[:BPF_PROFILES_]):
+        profile = bytearray(Profile._size)
+        try:
+            with io.open(path, "rb") as infile:
+                infile.readinto(profile)
+
+        except FileNotFoundError:
+            print(f"Failed to load profile '{path}'")
+            return False
+
+        table, unsupported = compile_bpf(profile)
+        if len(unsupported) > 0:
+            print(f"Warning: Profile {idx + 1} binds on keys " + " ".join(f"0x{key:02x}" for key in unsupported) + " need the kernel module (dropped)")
+
+        try:
+            subprocess.run(["bpftool", "map", "update", "pinned", BPF_KEYMAPS_, "key"] + [str(b) for b in idx.to_bytes(4, "little")]
+                + ["value"] + [str(b) for b in table], check = True)
+
+        except (FileNotFoundError, subprocess.CalledProcessError):
+            print("Could not update the HID-BPF keymaps. Is bpftool installed and the program loaded?")
+            return False
+
+    # Start over from profile 1 (see struct bpf_state)
+    try:
+        subprocess.run(["bpftool", "map", "update", "pinned", BPF_STATE_, "key", "0", "0", "0", "0", "value"] + ["1"] + ["0"] * 40, check = True)
+
+    except (FileNotFoundError, subprocess.CalledProcessError):
+        print("Could not reset the HID-BPF state. The new keymaps apply, but from the profile that was active")
+        return False
+
+    return True
+
 if __name__ == "__main__":
     # Parse args (not technically consts, sorry if you're malding rn)
     EXEC = sys.argv[0]
@@ -804,6 +1078,12 @@ if __name__ == "__main__":
     DATA = None
     SAVE = None
     LOAD = None
+    CONFIG = None
+    MACROS = None
+    STATE = False
+    WATCH = False
+    BPF = None
+    PACK = None
     HELP = False
 
     arglist = sys.argv[1:]
@@ -821,6 +1101,14 @@ if __name__ == "__main__":
             case "-v" | "--view" | "--show":
                 SHOW = True
                 
+            # Show the live device state (profile, hypershift, held keys)
+            case "-S" | "--state":
+                STATE = True
+
+            # Follow profile changes as they happen
+            case "-w" | "--watch":
+                WATCH = True
+
             # Swap device profile
             case "-c" | "--change" | "--swap":
                 try: PROFILE_NUM = int(arglist.pop(0), 0)
@@ -850,6 +1138,30 @@ if __name__ == "__main__":
             case "-l" | "--load":
                 LOAD = arglist.pop(0)
 
+            # Load a set of profiles from disk (profiles 1, 2, ...) in one go
+            case "-C" | "--config":
+                CONFIG = []
+                while len(arglist) > 0 and not arglist[0].startswith("-"):
+                    CONFIG.append(arglist.pop(0))
+
+                if len(CONFIG) == 0: HELP = True
+
+            # Load a set of profiles into the HID-BPF backend (no kernel module needed)
+            case "-B" | "--bpf":
+                BPF = []
+                while len(arglist) > 0 and not arglist[0].startswith("-"):
+                    BPF.append(arglist.pop(0))
+
+                if len(BPF) == 0: HELP = True
+
+            # Assemble and upload macros
+            case "-M" | "--macros":
+                MACROS = arglist.pop(0)
+
+            # Write the config (and macros) to a profile pack instead of the device
+            case "-P" | "--pack":
+                PACK = arglist.pop(0)
+
             # Unrecognized argument
             case _:
                 HELP = True
@@ -858,12 +1170,32 @@ if __name__ == "__main__":
             print("Usage:")
             print("  > Show profile: -v [profile num] | --view, --show")
             print("  > Change profile: -c <profile num> | --change, --swap")
-            print("  > Edit key: -m <key num> <type> <data> | --modify")
+            print("  > Show device state: -S | --state")
+            print("  > Follow profile changes: -w | --watch")
+            print("  > Edit key: -m <key num> <type> <data> | --modify   (EX: -m 1 1 ctrl+shift+t)")
             print("  > Save profile: -s <path> | --save")
             print("  > Load profile: -l <path> | --load")
+            print("  > Load all profiles: -C <path> [path ...] | --config")
+            print("  > Load macros: -M <path> | --macros")
+            print("  > Load profiles into the HID-BPF backend: -B <path> [path ...] | --bpf")
+            print("  > Write a profile pack (with -C and optionally -M): -P <path> | --pack")
             # print("  > Help: -h, -?, --help, --usage")
             exit()
 
+    # The HID-BPF backend works without the kernel module
+    if BPF:
+        print(f"Loading HID-BPF keymaps ({min(len(BPF), BPF_PROFILES_)} profiles)")
+        exit(0 if load_bpf(BPF) else 1)
+
+    # So does writing a profile pack
+    if PACK:
+        if not CONFIG:
+            print("A profile pack needs its profiles (-C)")
+            exit(1)
+
+        print(f"Writing profile pack '{PACK}' ({len(CONFIG)} profiles)")
+        exit(0 if save_pack(PACK, CONFIG, MACROS) else 1)
+
     # Determine keyboard interface device path
     DRIVERPATH_ = "/sys/bus/hid/drivers/hid-tartarus/"
     KBDPATH_ = None
@@ -892,6 +1224,14 @@ if __name__ == "__main__":
     MAXPROFILES_ = int(buf.decode("utf-8").split("\n", 1)[0])
 
     # Run
+    if CONFIG:
+        print(f"Loading config ({len(CONFIG)} profiles)")
+        load_config(CONFIG)
+
+    if MACROS:
+        print(f"Loading macros from '{MACROS}'")
+        load_macros(MACROS)
+
     if PROFILE_NUM > 0:
         if PROFILE_NUM > MAXPROFILES_:
             # TODO: The user might want to cancel their operation if this happens
@@ -906,6 +1246,15 @@ if __name__ == "__main__":
 
     if SHOW: change_profile(0, True)
 
+    if STATE:
+        state = read_state()
+        if state is not None:
+            profile, shift, revert, reports, events, held = state
+            print(f"> Profile: {profile}  Hypershift: {shift if revert else 'off'}  Reports: {reports}  Events: {events}")
+            print("> Held keys: " + (" ".join(f"0x{key:02x}" for key in held) or "none"))
+
+    if WATCH: watch_profile()
+
     if DATA:
         key = Profile._keys[int(DATA[0]) - 1]
         bind = Bind(DATA[1], DATA[2])
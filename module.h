@@ -5,135 +5,111 @@
 #endif
 #define _TARTARUS_HID
 
+#include <linux/completion.h>
+#include <linux/debugfs.h>
+#include <linux/firmware.h>
 #include <linux/hid.h>
+#include <linux/hidraw.h>
+#include <linux/hrtimer.h>
 #include <linux/kernel.h>
+#include <linux/list.h>
+#include <linux/mm.h>
 #include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/pm_runtime.h>
+#include <linux/rcupdate.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
 #include <linux/string.h>
 #include <linux/usb.h>
+#include <linux/version.h>
+#include <linux/wait.h>
+
+#include "translate.h"		// Device state and the input translation core
 
 // PROPERTIES
 #define VENDOR_ID		0x1532		// Razer USA, Ltd
 #define PRODUCT_ID		0x022b		// Tartarus_V2
 
-#define PROFILE_COUNT	8			// Number of profiles stored in the driver (each profile ~0.5 KB)
-#define KEYLIST_LEN		8			// Maximum number device-supported simultaneous keypresses (6 normal keys + shift and alt)
-#define KEYMAP_LEN		0x100		// Number of entries in a complete keymap
 #define REPORT_LEN  	0x5A		// Size of a USB control report (90 bytes)
 
+#define CFG_VERSION_MAJOR	2	// Binary config format (see struct config) ; 2.0 widened struct bind
+#define CFG_VERSION_MINOR	0
+#define CFG_MAX_LEN	(sizeof(struct config) + PROFILE_MAX * sizeof(struct profile))
+#define MCR_VERSION_MAJOR	1	// Binary macro format (see struct macrocfg)
+#define MCR_VERSION_MINOR	0
+#define MCR_MAX_LEN	(sizeof(struct macrocfg) + MACRO_CODE_LEN)
+#define STATE_VERSION		1	// Shared state page format (see struct statepage)
+
+#define CACHE_DEVICES	8			// Pads whose profiles are kept after they disconnect (see struct cfgcache)
+#define CACHE_KEY_LEN	64			// Serial number or phys string identifying a pad
+
+// SYSFS NOTIFICATIONS (bit numbers of drvdata notify)
+#define NOTIFY_PROFILE	0			// profile_num changed
+#define NOTIFY_STATE	1			// Profile or hypershift state changed (state)
+#define NOTIFY_CONFIG	2			// Profiles were uploaded (config)
+#define NOTIFY_MACROS	3			// Macros were uploaded (macros)
+
 #define KBD_INUM		0x00		// Interface number of the keyboard is 0
 #define EXT_INUM		0x01		// Unknown interface (keyboard?)
 #define MOUSE_INUM		0x02 		// Interface number of the mouse (wheel) is 2
 
+#define REPORT_CONSUMED	-1			// .raw_event result which stops hid-core from processing a report the driver handled
+#define FRAME_EVENTS	(EVENT_MAX + 2 * KEYLIST_LEN + 2 * BMOD_COUNT)	// Input events of one frame: a whole report, a swap of every held key, and each modifier up and down again
+
 
 // COMMANDS (TODO: Consider removing old URB functions, making these obsolete)
 #define CMD_KBD_LAYOUT  0x00, 0x86, 0x02	// Query the device for its keyboard layout
 #define CMD_SET_LED     0x03, 0x00, 0x03	// Set a specified LED with a given value
 
-
-// KEYS
-#define RZKEY_01		0x1E		// Funny names because we'd conflict with existing defines in linux kernel
-#define RZKEY_02		0x1F
-#define RZKEY_03		0x20
-#define RZKEY_04		0x21
-#define RZKEY_05		0X22
-#define RZKEY_06		0x2B
-#define RZKEY_07		0x14
-#define RZKEY_08		0x1A
-#define RZKEY_09		0x08
-#define RZKEY_10		0x15
-#define RZKEY_11		0x39
-#define RZKEY_12		0x04
-#define RZKEY_13		0x16
-#define RZKEY_14		0x07
-#define RZKEY_15		0x09
-#define RZKEY_16		0x42		// (Actual 0x02 -> Shift)
-#define RZKEY_17		0x1D
-#define RZKEY_18		0x1B
-#define RZKEY_19		0x06
-#define RZKEY_20		0x2C
-#define RZKEY_CIRCLE	0x44		// (Actual 0x04 -> Alt)
-#define RZKEY_THMB_L	0x50
-#define RZKEY_THMB_U	0x52
-#define RZKEY_THMB_R	0x4F
-#define RZKEY_THMB_D	0x51
-
-#define MODKEY_SHIFT	0x02		// Bit pattern for the shift key (key 16)
-#define MODKEY_ALT		0x04		// Bit pattern for the alt key (circular thumb button)
-#define MODKEY_MASK		0x40		// Applied to all modkey keycodes (i.e. 0000 0010 (lshift) -> 0100 0010)
-#define MWHEEL_BTN		0x04		// Bit pattern for the mouse wheel button
-#define MWHEEL_WHEEL	0x08
-
-// BINDS
-#define CTRL_NOP		0x00		// No key action
-#define CTRL_KEY     	0x01		// Keyboard button
-#define CTRL_SHIFT      0x02		// Hypershift mode	(swap profile while held)
-#define CTRL_PROFILE   	0x03		// Change profile	(swap profile upon press)
-#define CTRL_MACRO		0x04		// TODO: Play macro action 		(playback list of key actions)
-#define CTRL_SCRIPT		0x05		// TODO: Execute script relative to the current user's home dir
-#define CTRL_SWKEY		0x06		// TODO: Key that will be "swapped" upon hypershift state change
-#define CTRL_MMOV		0x07		// TODO: Move the mouse
-#define CTRL_MWHEEL		0x08		// TODO: Mouse wheel action
-#define CTRL_DEBUG		0xFF		// (DEBUG)
+// LEDS
+#define LED_RED			0x0C		// LED indices (CMD_SET_LED data[1])
+#define LED_GREEN		0x0D
+#define LED_BLUE		0x0E
+#define LED_MASK		0x07		// Profile LED bits (R: 0x04, G: 0x02, B: 0x01)
+
+#define STATUS_NEW		0x00		// Device response status (razer_report status)
+#define STATUS_BUSY		0x01
+#define STATUS_OK		0x02
+#define STATUS_FAIL		0x03
+#define STATUS_TIMEOUT	0x04
+#define STATUS_UNSUPPORTED	0x05
+
+// DEVICE COMMAND QUEUE (see struct cmdqueue)
+#define CMD_SLOTS		8			// Commands queued at once (power of 2)
+#define CMD_DELAY_US	600			// Time the device needs before its response can be read
+#define CMD_RETRIES		5			// Response re-reads while the device is busy (the delay doubles each time)
+#define CMD_TIMEOUT_MS	500			// Longest a single transfer may take before it is unlinked
+#define CMD_STATS		8			// Distinct commands tracked by the debugfs 'commands' file
+#define CMD_WAKE_US		2000		// Retry delay of a transfer refused while the device resumes from autosuspend
+#define CMD_WAKE_TRIES	(CMD_TIMEOUT_MS * 1000 / CMD_WAKE_US)
+
+#define CMDQ_IDLE		0			// Nothing in flight
+#define CMDQ_WAIT		1			// Timer pending to start the next transfer
+#define CMDQ_BUSY		2			// Transfer in flight (the timer is its watchdog)
+#define CMDQ_SEND		0			// Transfer stages: request (SET_REPORT) and response (GET_REPORT)
+#define CMDQ_READ		1
 
 
 // STRUCTS
-// Defines the behavior of a key
-struct bind {
-	u8 type;		// Event type
-	u8 data;		// Respective data (key code or index of macro)
-};
-
-// Single event and its respective state
-struct event {
-	u8 idx;			// "Key" index
-	u8 state;		// 0: Release ; 1: Press
-};
-
-// Bitmap container for interface key states
-struct keystate {
-	union {
-		u8 bytes [32];
-		u32 data [8];
-	};
-};
-
-// Device driver data (for passing data across functions; unique per interface)
-struct drvdata {
-	u8 profile;					// Active profile number (keyboard and mouse have one each)
-	u8 inum;					// Interface number : 0 -> KB, 1 -> RGB???, 2 -> Mouse (wheel)
-	void* idata;				// Interface data (keyboard, mouse, etc.)
-	struct usb_device* parent;	// Parent device ref (for sending URBs)
-	struct input_dev* input;	// Input device ref (for sending inputs to kernel)
-	struct mutex lock;
-};
-
-// Driver data for keyboard interface
-struct kbddata {
-	u8 keylist [KEYLIST_LEN];			// Device button state
-	struct keystate shift_keylist;		// Keys pressed within hypershift mode
-	struct keystate ignore_keylist;		// Keys where their release should be ignored
-	
-	u8 shift;							// Current hypershift profile number
-	u8 revert;							// Hypershift return profile number ; 0 -> NOP
-	
-	// Device profiles numbers range 1-8, corresponding to indexes 0-7 ; 0 -> Device disabled
-	struct profile {
-		struct bind keymap [KEYMAP_LEN];
-	} maps [PROFILE_COUNT];
+struct razer_report;
+
+// Device control channel
+// Input reports arrive through hid-core regardless of transport, but device commands (LEDs, queries)
+// need a backend: USB control transfers for the real pad or a stub for virtual (UHID) devices
+// Backends move data->cmdq->context one stage (CMDQ_SEND / CMDQ_READ) at a time and report each with complete_command()
+struct ctrl_backend {
+	const char* name;
+	int (*open) (struct drvdata*);			// Preallocate transfer resources
+	int (*submit) (struct drvdata*, u8);	// Start a transfer stage ; must not sleep
+	void (*cancel) (struct drvdata*);		// Abort the transfer in flight (watchdog) ; must not sleep
+	void (*close) (struct drvdata*);		// Stop for good: wait out the transfer in flight and fail any later one
+	int (*get) (struct drvdata*);			// Keep the device awake while commands are queued (resumes it if autosuspended) ; must not sleep
+	void (*put) (struct drvdata*);			// Let it autosuspend again ; must not sleep
 };
 
-struct mousedata {
-	// u8 mwheel_state;					// Value directly from raw event (not clamped)
-	struct mprofile {
-		struct bind keymap [8];
-	} maps [PROFILE_COUNT];
-};
-
-// TODO: Wild idea for a "mouse" bind
-// 		 Middle click on the scroll wheel goes to "profile mode"
-//		 Rolling the wheel up or down (in this mode) will "roll" through the profiles
-//		 EX: I might have a couple different profiles for convenient binds for portal 2 speedruns
-
 // Format of the 90 byte device response
 // (Taken from OpenRazer driver)
 struct razer_report {
@@ -205,39 +181,194 @@ struct razer_report {
 // Buffers for asynchronous control URBs
 struct urb_context {
 	struct usb_ctrlrequest setup;
-	struct razer_report req;
+	struct razer_report req;		// Request on the way out, response on the way back
+};
+
+// One queued device command
+// done runs once the command is over (from atomic context): resp is the device response, or NULL if none was read
+struct command {
+	struct razer_report req;		// Transaction ID and checksum are filled in when queued
+	void (*done) (struct drvdata*, void* ctx, const struct razer_report* resp, int status);		// NULL -> Fire and forget
+	void* ctx;
+	u64 queued_ns;					// latency_start() when queued
+};
+
+// Per-command statistics (debugfs 'commands' file)
+struct cmdstats {
+	u8 class;						// Command (class and id) ; count == 0 -> Unused
+	u8 id;
+	u32 count;						// Commands completed (successfully or not)
+	u32 busy;						// Busy (or stale) responses re-read
+	u32 failed;
+	u64 total_ns;					// Queued -> completed
+	u64 max_ns;
 };
 
-/*/ TODO: Sysfs format
-// The following currently exists exclusively for reference
+// Device command queue (keyboard interface only)
+// The device answers one request at a time, so commands run in order: SET_REPORT, a delay, then GET_REPORT
+// The delay, busy backoff, and transfer watchdog are all driven by one timer, so no caller ever sleeps
+// Every transfer is started from the timer, which keeps a watchdog expiry from ever unlinking a newer transfer
+struct cmdqueue {
+	spinlock_t lock;
+	struct command cmds [CMD_SLOTS];	// Ring buffer ; cmds[head] is the current command unless CMDQ_IDLE
+	u8 head;
+	u8 len;
+	u8 state;						// CMDQ_IDLE, CMDQ_WAIT, CMDQ_BUSY
+	u8 stage;						// CMDQ_SEND, CMDQ_READ (next or current transfer)
+	u8 retries;						// Busy responses of the current command
+	u8 timedout;					// The watchdog cancelled the transfer in flight
+	u8 dead;						// Closing: new commands are refused
+	u8 awake;						// Holds the device awake (ctrl get) until the queue drains
+	u8 waking;						// Transfers of the current stage refused while the device resumes
+
+	struct urb_context* context;	// Preallocated transfer buffers (DMA-safe)
+	struct urb* urb;				// Preallocated control URB (USB backend)
+	struct hrtimer timer;
+	wait_queue_head_t idle;			// Woken whenever the queue drains
+	struct drvdata* data;
+
+	struct cmdstats stats [CMD_STATS];
+	u32 overflow;					// Commands refused because the queue was full
+};
+
+// Waiter of send_command()
+struct cmdwait {
+	struct completion done;
+	struct razer_report* out;
+	int status;
+};
+
+// Profile LED pipeline (keyboard interface only)
+// At most one LED command is ever queued ; requests made in the meantime are coalesced, so only the most recent LED state is sent
+// The firmware takes one LED per command, so only the LEDs which actually change are sent
+struct ledctl {
+	spinlock_t lock;
+	u8 desired;						// Requested LED bits
+	u8 shown;						// LED bits as last acknowledged by the device
+	u8 known;						// LED bits whose state on the device is known
+	u8 inflight;					// LED bit of the queued command ; 0 -> Idle
+
+	struct razer_report req;		// Queued command (copied into the command queue)
+
+	// Statistics (exposed through led_stats)
+	u32 submitted;					// Commands handed to the command queue
+	u32 coalesced;					// Requests which replaced one whose commands were not sent yet
+	u32 failed;						// Commands which failed to queue or complete
+};
+
+// Macro sequencer (keyboard interface only)
+// Steps are scheduled against absolute deadlines (struct macroplay 'due') so delays never accumulate drift
+struct macroctl {
+	struct hrtimer timer;
+	struct drvdata* data;
+};
+
+// Latency histograms (debugfs 'latency' file)
+// Log2 buckets of nanoseconds: bucket n counts durations in [2^(n-1), 2^n) ; the last bucket also holds everything above
+// Allocated per-CPU so that the report path never shares a cache line with readers or other CPUs
+#define LAT_BUCKETS		32
+struct latency {
+	u64 hist [LAT_STAGES][LAT_BUCKETS];
+};
+
+// Report arrival times of one interface (see jitter_record())
+// Reports only arrive when something changed, so the gap between two of them is a whole number of polling intervals:
+// how far each gap falls from the nearest multiple of the nominal interval is its jitter
+// The report rate only reaches the polling rate while reports keep coming (i.e. the wheel spinning), hence the peak
+// Guarded by state_lock (the report path takes it anyway)
+struct jitter {
+	u32 interval_us;				// Nominal polling interval (endpoint descriptor) ; 0 -> Unknown (virtual device)
+	u64 last_ns;					// Arrival of the previous report ; 0 -> None yet
+	u64 reports;
+	u64 min_gap_ns;					// Shortest gap between two reports
+	u64 window_ns;					// Start of the current one second window
+	u32 window_reports;				// Reports within it
+	u32 peak_hz;					// Most reports within any window
+	u64 max_ns;						// Largest offset seen
+	u64 hist [LAT_BUCKETS];			// Offset from the polling grid (log2 buckets of nanoseconds, like struct latency)
+};
+
+// Binary config format (sysfs 'config' file)
+// Holds every keyboard profile so that a full configuration is loaded with a single write
+// The device holds exactly num_profiles afterwards ; the active profile number and LEDs are left untouched
+// Profiles are sent dense and stored sparse, as the differences from the base profile (see struct kbdmaps)
 struct config {
-	u8 version_major;		// First half of the config version
-	u8 version_minor;		// Second half of the config version
-	u8 num_profiles;		// How many profiles exist in the config
-	u8 num_macros;			// How many macros are defined in the config*
-	u32 unused;
+	u8 version_major;		// Must match CFG_VERSION_MAJOR
+	u8 version_minor;		// Newer minor versions only append fields
+	u8 num_profiles;		// How many profiles follow the header (1 - PROFILE_MAX)
+	u8 num_macros;			// Must be 0 (macros are uploaded through the 'macros' file)
+	u8 base;				// Profile whose binds the others share (0 -> None)
+	u8 unused [3];
+
+	struct profile profiles [];		// Same layout as the 'profile' file (KEYMAP_LEN binds of 4 bytes each: type, mods, u16 data)
+};
+
+// Binary macro format (sysfs 'macros' file)
+// Macros are stored back to back in index order ; size[n] == 0 leaves macro n undefined
+// The whole table must be written at once (it always fits within a single page)
+struct macrocfg {
+	u8 version_major;		// Must match MCR_VERSION_MAJOR
+	u8 version_minor;
+	u16 len;				// Total bytes of code following the header
+	u16 size [MACRO_COUNT];	// Bytes of code (including MOP_END) of each macro
 
-	// Array of profile types
-	struct profile {
-		u8 led;				// Profile indicator light(s) (TODO: Consider automating this based upon profile number)
-		struct bind keymap[0xFF];
-	}* profiles;
-	// struct bind (* keymap)[0xFF];	// NOTE: Syntax equivalent to the above omitting the led field
+	u8 code [];				// See MOP_* (translate.h)
+};
 
-	// struct macro* macros;			// Macros are of variable length (TODO: Consider moving them to seperate file)
-}; //*/
+// Config cache entry (see cache_store())
+// Holds the very tables the pad was using, so nothing is copied on the way in or out
+struct cfgcache {
+	struct list_head list;
+	char key [CACHE_KEY_LEN];		// See cache_key()
+	struct kbdmaps* maps;
+	struct macros* macros;			// NULL -> None uploaded
+	u8 profile;						// Active profile number (base layer)
+};
+
+// Shared state page (sysfs 'state' file)
+// Userspace maps it read-only and samples it without any syscalls
+// Updates are bracketed by seq (a seqcount): it is odd while an update is in progress, so a reader
+// copies what it needs and retries if seq was odd or changed in the meantime
+struct statepage {
+	u32 seq;
+	u8 version;				// STATE_VERSION
+	u8 profile;				// Active profile number (0 -> Disabled)
+	u8 shift;				// Profile of the topmost hypershift layer ; 0 -> Not in hypershift
+	u8 revert;				// Base profile under the hypershift layers ; 0 -> Not in hypershift
+	u32 reports;			// Raw reports handled
+	u32 events;				// Key events decoded from them
+	struct keystate keys;	// Held keys (bitmap of raw key indices, as in struct profile)
+};
+
+// struct bin_attribute callbacks take a const attribute since the sysfs constification
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 16, 0)
+#define BIN_ATTR_T const struct bin_attribute
+#else
+#define BIN_ATTR_T struct bin_attribute
+#endif
 
 
 // HANLDERS (device event hooks)
+static int device_inum (struct hid_device*, u8*);
+static u32 device_interval (struct hid_device*);
 static int device_probe (struct hid_device*, const struct hid_device_id*);
 static int input_config (struct hid_device*, struct hid_input*);
 static void device_disconnect (struct hid_device*);
+#ifdef CONFIG_PM
+static int device_suspend (struct hid_device*, pm_message_t);
+static int device_resume (struct hid_device*);
+static int device_reset_resume (struct hid_device*);
+static int autosuspend_kbd (struct drvdata*);
+static int resume_kbd (struct drvdata*, u8);
+#endif
 static int handle_event (struct hid_device*, struct hid_report*, u8*, int);
+// Maps no usages: hid-input still creates the input devices, but every report is handled (and consumed) by .raw_event
 static int mapping_bypass (struct hid_device* hdev, struct hid_input* hidinput, struct hid_field* field,
 			struct hid_usage* usage, unsigned long** bit, int* max) { return -1; }
 
 static ssize_t intf_type (struct device*, struct device_attribute*, char*);
-static ssize_t profile_count (struct device*, struct device_attribute*, char*);
+static ssize_t profile_count_show (struct device*, struct device_attribute*, char*);
+static ssize_t profile_count_store (struct device*, struct device_attribute*, const char*, size_t);
 
 static ssize_t profile_num_show (struct device*, struct device_attribute*, char*);
 static ssize_t profile_num_store (struct device*, struct device_attribute*, const char*, size_t);
@@ -245,34 +376,133 @@ static ssize_t profile_num_store (struct device*, struct device_attribute*, cons
 static ssize_t profile_show (struct device*, struct device_attribute*, char*);
 static ssize_t profile_store (struct device*, struct device_attribute*, const char*, size_t);
 
+static ssize_t led_stats (struct device*, struct device_attribute*, char*);
+
+static ssize_t config_read (struct file*, struct kobject*, BIN_ATTR_T*, char*, loff_t, size_t);
+static ssize_t config_write (struct file*, struct kobject*, BIN_ATTR_T*, char*, loff_t, size_t);
+static int load_config (struct drvdata*, const u8*, size_t);
+static int decode_config (const u8*, size_t, struct kbdmaps**);
+static struct kbdmaps* build_maps (const struct profile*, u8, u8, const struct kbdmaps*, const struct profile*, u8, u8);
+static struct kbdmaps* publish_maps (struct drvdata*, struct kbdmaps*);
+
+static ssize_t macros_read (struct file*, struct kobject*, BIN_ATTR_T*, char*, loff_t, size_t);
+static ssize_t macros_write (struct file*, struct kobject*, BIN_ATTR_T*, char*, loff_t, size_t);
+static int load_macros (struct drvdata*, const u8*, size_t);
+static int decode_macros (const u8*, size_t, struct macros**);
+
+static ssize_t state_read (struct file*, struct kobject*, BIN_ATTR_T*, char*, loff_t, size_t);
+static int state_mmap (struct file*, struct kobject*, BIN_ATTR_T*, struct vm_area_struct*);
+void publish_state (struct drvdata*, int);
+void notify_change (struct drvdata*, int);
+void notify_work (struct work_struct*);
+
+static int __init module_load (void);
+static void __exit module_unload (void);
+
+// CONFIG CACHE
+static const char* cache_key (struct hid_device*);
+static int cache_restore (struct hid_device*, struct kbdmaps**, struct macros**, u8*);
+static void cache_store (struct hid_device*, struct drvdata*);
+static void cache_clear (void);
+static int cache_insert (struct hid_device*, struct kbdmaps*, struct macros*, u8);
+static void cache_free (struct cfgcache*);
+static int load_pack (struct hid_device*, struct kbdmaps**, struct macros**);
+
+// DEBUGFS
+static void debugfs_init (struct hid_device*, struct drvdata*);
+static int latency_show (struct seq_file*, void*);
+static ssize_t latency_reset (struct file*, const char __user*, size_t, loff_t*);
+static int swaps_show (struct seq_file*, void*);
+static int commands_show (struct seq_file*, void*);
+static int jitter_show (struct seq_file*, void*);
+static void jitter_record (struct jitter*, u64);
+
 
 // INPUT PROCESSING
 void log_event (u8*, int, u8);
-int process_event_kbd (struct event*, u8*, u8*, int);
-void resolve_event_kbd (struct event*, struct drvdata*);
-u8 lookup_profile_kbd (struct kbddata*, struct bind*, u8, u8, u8);
-void swap_profile_kbd (struct drvdata*, u8, struct keystate*);
-void set_profile (struct drvdata*, u8);
-int process_event_mouse (struct event*, u8*, int);
-void resolve_event_mouse (struct event*, struct drvdata*);
-// void swap_profile_mouse ( ... );
 
-// void swap_profile_kbd_old (struct device*, struct drvdata*, u8);
+// MACROS
+int init_macro (struct drvdata*);
+void free_macro (struct drvdata*);
+void schedule_macro (struct drvdata*);
+enum hrtimer_restart macro_timer (struct hrtimer*);
 
 // DEVICE COMMANDS
 void log_report (struct razer_report*);
 unsigned char report_checksum (struct razer_report*);
 struct razer_report init_report (unsigned char, unsigned char, unsigned char);
-struct razer_report send_command (struct device*, struct razer_report*, int*);
-void set_profile_led (struct drvdata*, u8, u8);
-void set_profile_led_complete (struct urb*);
+int init_command_queue (struct drvdata*);
+void free_command_queue (struct drvdata*);
+void drain_command_queue (struct drvdata*, unsigned int);
+void kick_command_queue (struct drvdata*);
+int queue_command (struct drvdata*, const struct razer_report*, void (*) (struct drvdata*, void*, const struct razer_report*, int), void*);
+int send_command (struct drvdata*, const struct razer_report*, struct razer_report*);
+void send_command_complete (struct drvdata*, void*, const struct razer_report*, int);
+enum hrtimer_restart command_timer (struct hrtimer*);
+void complete_command (struct drvdata*, int);
+int retry_command (struct cmdqueue*);
+int command_status (const struct razer_report*, const struct razer_report*);
+void record_command (struct cmdqueue*, const struct command*, int);
+int init_profile_led (struct drvdata*);
+void free_profile_led (struct drvdata*);
+void set_profile_led (struct drvdata*, u8);
+void resync_profile_led (struct drvdata*);
+int next_profile_led (struct ledctl*);
+void submit_profile_led (struct drvdata*);
+void set_profile_led_complete (struct drvdata*, void*, const struct razer_report*, int);
+
+int ctrl_usb_open (struct drvdata*);
+int ctrl_usb_submit (struct drvdata*, u8);
+void ctrl_usb_cancel (struct drvdata*);
+void ctrl_usb_close (struct drvdata*);
+void ctrl_usb_complete (struct urb*);
+int ctrl_usb_get (struct drvdata*);
+void ctrl_usb_put (struct drvdata*);
+int ctrl_stub_open (struct drvdata*);
+int ctrl_stub_submit (struct drvdata*, u8);
+void ctrl_stub_cancel (struct drvdata*);
+void ctrl_stub_close (struct drvdata*);
+int ctrl_stub_get (struct drvdata*);
+void ctrl_stub_put (struct drvdata*);
+
+// CONTROL BACKENDS
+static const struct ctrl_backend ctrl_usb = {
+	.name = "usb",
+	.open = ctrl_usb_open,
+	.submit = ctrl_usb_submit,
+	.cancel = ctrl_usb_cancel,
+	.close = ctrl_usb_close,
+	.get = ctrl_usb_get,
+	.put = ctrl_usb_put
+};
+
+static const struct ctrl_backend ctrl_stub = {
+	.name = "stub",
+	.open = ctrl_stub_open,
+	.submit = ctrl_stub_submit,
+	.cancel = ctrl_stub_cancel,
+	.close = ctrl_stub_close,
+	.get = ctrl_stub_get,
+	.put = ctrl_stub_put
+};
 
 
 // DEVICE ATTRIBUTES (connects functions to udev events)
 static DEVICE_ATTR(intf_type, 0444, intf_type, NULL);
-static DEVICE_ATTR(profile_count, 0444, profile_count, NULL);
+static DEVICE_ATTR(profile_count, 0644, profile_count_show, profile_count_store);
 static DEVICE_ATTR(profile_num, 0644, profile_num_show, profile_num_store);		// static DEVICE_ATTR_RW(profile_num);
 static DEVICE_ATTR(profile, 0644, profile_show, profile_store);
+static DEVICE_ATTR(led_stats, 0444, led_stats, NULL);
+static BIN_ATTR(config, 0644, config_read, config_write, CFG_MAX_LEN);
+static BIN_ATTR(macros, 0644, macros_read, macros_write, MCR_MAX_LEN);
+
+// (BIN_ATTR() has no mmap callback)
+static struct bin_attribute bin_attr_state = {
+	.attr = { .name = "state", .mode = 0444 },
+	.size = PAGE_SIZE,
+	.read = state_read,
+	.mmap = state_mmap
+};
 
 
 // MODULE
@@ -294,8 +524,42 @@ static struct hid_driver hid_tartarus = {
 	.probe = device_probe,
 	.remove = device_disconnect,
 	.raw_event = handle_event,
-	.input_mapping = mapping_bypass
+	.input_mapping = mapping_bypass,
+#ifdef CONFIG_PM
+	.suspend = device_suspend,
+	.resume = device_resume,
+	.reset_resume = device_reset_resume,
+#endif
+};
+
+DEFINE_SHOW_ATTRIBUTE(latency);
+DEFINE_SHOW_ATTRIBUTE(swaps);
+DEFINE_SHOW_ATTRIBUTE(commands);
+DEFINE_SHOW_ATTRIBUTE(jitter);
+
+static const struct file_operations latency_reset_fops = {
+	.owner = THIS_MODULE,
+	.open = simple_open,
+	.write = latency_reset
 };
 
+static struct dentry* debug_root;		// /sys/kernel/debug/tartarus
+
+static LIST_HEAD(config_cache);			// Most recently disconnected pad first
+static DEFINE_MUTEX(config_cache_lock);
+
+static char* profile_pack = "tartarus-profiles.bin";
+module_param(profile_pack, charp, 0444);
+MODULE_PARM_DESC(profile_pack, "Firmware file to load profiles from when a pad is first seen (empty -> Hard-coded defaults)");
+
+static bool autosuspend = false;
+module_param(autosuspend, bool, 0444);
+MODULE_PARM_DESC(autosuspend, "Autosuspend idle pads, at the cost of a slower first keypress (0 -> Leave runtime power management alone)");
+
+static int autosuspend_delay = -1;
+module_param(autosuspend_delay, int, 0444);
+MODULE_PARM_DESC(autosuspend_delay, "Idle time (ms) before a pad is autosuspended (-1 -> Keep the delay usbcore or udev set)");
+
 // Initalize the module with the kernel
-module_hid_driver(hid_tartarus);
+module_init(module_load);
+module_exit(module_unload);
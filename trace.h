@@ -0,0 +1,210 @@
+// Tracepoints for the report -> bind -> input pipeline
+// Use with perf/ftrace/bpftrace (i.e. `perf record -e 'tartarus:*'`) ; these cost nothing while disabled
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM tartarus
+
+#if !defined(_TARTARUS_TRACE) || defined(TRACE_HEADER_MULTI_READ)
+#define _TARTARUS_TRACE
+
+#include <linux/tracepoint.h>
+
+// Raw report arrival (.raw_event entry)
+TRACE_EVENT(tartarus_report,
+	TP_PROTO(u8 inum, const u8* raw, int len),
+	TP_ARGS(inum, raw, len),
+
+	TP_STRUCT__entry(
+		__field(u8, inum)
+		__dynamic_array(u8, raw, len)
+	),
+
+	TP_fast_assign(
+		__entry->inum = inum;
+		memcpy(__get_dynamic_array(raw), raw, len);
+	),
+
+	TP_printk("inum=%u raw=%s", __entry->inum,
+		__print_hex(__get_dynamic_array(raw), __get_dynamic_array_len(raw)))
+);
+
+// Single key event decoded from a report
+TRACE_EVENT(tartarus_event,
+	TP_PROTO(u8 inum, const struct event* ev),
+	TP_ARGS(inum, ev),
+
+	TP_STRUCT__entry(
+		__field(u8, inum)
+		__field(u8, idx)
+		__field(u8, state)
+	),
+
+	TP_fast_assign(
+		__entry->inum = inum;
+		__entry->idx = ev->idx;
+		__entry->state = ev->state;
+	),
+
+	TP_printk("inum=%u key=0x%02x state=%s", __entry->inum, __entry->idx, __entry->state ? "DOWN" : "UP")
+);
+
+// Keybind resolved for a key event
+// Releases report the bind the key was pressed with
+TRACE_EVENT(tartarus_bind,
+	TP_PROTO(u8 profile, const struct event* ev, const struct bind* action, u8 depth),
+	TP_ARGS(profile, ev, action, depth),
+
+	TP_STRUCT__entry(
+		__field(u8, profile)
+		__field(u8, idx)
+		__field(u8, state)
+		__field(u8, type)
+		__field(u8, mods)
+		__field(u16, data)
+		__field(u8, depth)
+	),
+
+	TP_fast_assign(
+		__entry->profile = profile;
+		__entry->idx = ev->idx;
+		__entry->state = ev->state;
+		__entry->type = action->type;
+		__entry->mods = action->mods;
+		__entry->data = action->data;
+		__entry->depth = depth;
+	),
+
+	TP_printk("profile=%u layers=%u key=0x%02x state=%s -> type=0x%02x mods=0x%02x data=0x%02x",
+		__entry->profile, __entry->depth, __entry->idx, __entry->state ? "DOWN" : "UP", __entry->type, __entry->mods, __entry->data)
+);
+
+// Hypershift layer added (press) or removed (release)
+TRACE_EVENT(tartarus_hypershift,
+	TP_PROTO(u8 enter, u8 profile, u8 depth),
+	TP_ARGS(enter, profile, depth),
+
+	TP_STRUCT__entry(
+		__field(u8, enter)
+		__field(u8, profile)
+		__field(u8, depth)
+	),
+
+	TP_fast_assign(
+		__entry->enter = enter;
+		__entry->profile = profile;
+		__entry->depth = depth;
+	),
+
+	TP_printk("%s profile=%u layers=%u", __entry->enter ? "push" : "pop", __entry->profile, __entry->depth)
+);
+
+// Held keys carried across a profile change
+// swapped -> Keys which emitted input (release and/or press) ; ignored -> Keys whose release will be ignored
+TRACE_EVENT(tartarus_swap,
+	TP_PROTO(u8 from, u8 to, u8 swapped, u8 ignored),
+	TP_ARGS(from, to, swapped, ignored),
+
+	TP_STRUCT__entry(
+		__field(u8, from)
+		__field(u8, to)
+		__field(u8, swapped)
+		__field(u8, ignored)
+	),
+
+	TP_fast_assign(
+		__entry->from = from;
+		__entry->to = to;
+		__entry->swapped = swapped;
+		__entry->ignored = ignored;
+	),
+
+	TP_printk("profile %u -> %u swapped=%u ignored=%u", __entry->from, __entry->to, __entry->swapped, __entry->ignored)
+);
+
+// Profile LED command handed to the command queue
+TRACE_EVENT(tartarus_led_submit,
+	TP_PROTO(u8 led, u8 state),
+	TP_ARGS(led, state),
+
+	TP_STRUCT__entry(
+		__field(u8, led)
+		__field(u8, state)
+	),
+
+	TP_fast_assign(
+		__entry->led = led;
+		__entry->state = state;
+	),
+
+	TP_printk("led=0x%02x state=%u", __entry->led, __entry->state)
+);
+
+// Profile LED command completed
+TRACE_EVENT(tartarus_led_complete,
+	TP_PROTO(u8 led, int status),
+	TP_ARGS(led, status),
+
+	TP_STRUCT__entry(
+		__field(u8, led)
+		__field(int, status)
+	),
+
+	TP_fast_assign(
+		__entry->led = led;
+		__entry->status = status;
+	),
+
+	TP_printk("led=0x%02x status=%d", __entry->led, __entry->status)
+);
+
+// Device command completed (or failed) ; retries counts the busy responses re-read
+TRACE_EVENT(tartarus_command,
+	TP_PROTO(u8 class, u8 id, u8 tr_id, u8 retries, int status),
+	TP_ARGS(class, id, tr_id, retries, status),
+
+	TP_STRUCT__entry(
+		__field(u8, class)
+		__field(u8, id)
+		__field(u8, tr_id)
+		__field(u8, retries)
+		__field(int, status)
+	),
+
+	TP_fast_assign(
+		__entry->class = class;
+		__entry->id = id;
+		__entry->tr_id = tr_id;
+		__entry->retries = retries;
+		__entry->status = status;
+	),
+
+	TP_printk("cmd=0x%02x:0x%02x tr_id=0x%02x retries=%u status=%d", __entry->class, __entry->id,
+		__entry->tr_id, __entry->retries, __entry->status)
+);
+
+// First key event after the device resumed ; ns since its resume callback
+// autosuspend -> The device was woken from autosuspend (usually by that very keypress), otherwise from a system sleep
+TRACE_EVENT(tartarus_wake,
+	TP_PROTO(u8 autosuspend, u64 resume_ns),
+	TP_ARGS(autosuspend, resume_ns),
+
+	TP_STRUCT__entry(
+		__field(u8, autosuspend)
+		__field(u64, delta)
+	),
+
+	TP_fast_assign(
+		__entry->autosuspend = autosuspend;
+		__entry->delta = ktime_get_ns() - resume_ns;
+	),
+
+	TP_printk("%s first_event_ns=%llu", __entry->autosuspend ? "autosuspend" : "system", __entry->delta)
+);
+
+#endif
+
+// This part must be outside protection
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE trace
+#include <trace/define_trace.h>
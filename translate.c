@@ -0,0 +1,704 @@
+#include "translate.h"		// Translation core (shared by the module and userspace builds)
+
+#ifdef __KERNEL__
+#include "trace.h"			// Tracepoints (created in driver.c)
+#endif
+
+// -- INPUT TRANSLATION --
+// Everything in here is free of kernel-only dependencies so it may also be built in userspace
+// Output goes through report_key() / report_rel() and profile changes through set_profile()
+
+// Raw key -> slot of struct padmap (0 -> Not a key of the pad)
+static const u8 pad_index [KEYMAP_LEN] = {
+	[RZKEY_01] = 1, [RZKEY_02] = 2, [RZKEY_03] = 3, [RZKEY_04] = 4, [RZKEY_05] = 5,
+	[RZKEY_06] = 6, [RZKEY_07] = 7, [RZKEY_08] = 8, [RZKEY_09] = 9, [RZKEY_10] = 10,
+	[RZKEY_11] = 11, [RZKEY_12] = 12, [RZKEY_13] = 13, [RZKEY_14] = 14, [RZKEY_15] = 15,
+	[RZKEY_16] = 16, [RZKEY_17] = 17, [RZKEY_18] = 18, [RZKEY_19] = 19, [RZKEY_20] = 20,
+	[RZKEY_CIRCLE] = 21, [RZKEY_THMB_L] = 22, [RZKEY_THMB_U] = 23, [RZKEY_THMB_R] = 24, [RZKEY_THMB_D] = 25
+};
+
+// Slot of struct padmap -> raw key (inverse of pad_index)
+static const u8 pad_key [PAD_KEYS + 1] = {
+	0x00,
+	RZKEY_01, RZKEY_02, RZKEY_03, RZKEY_04, RZKEY_05,
+	RZKEY_06, RZKEY_07, RZKEY_08, RZKEY_09, RZKEY_10,
+	RZKEY_11, RZKEY_12, RZKEY_13, RZKEY_14, RZKEY_15,
+	RZKEY_16, RZKEY_17, RZKEY_18, RZKEY_19, RZKEY_20,
+	RZKEY_CIRCLE, RZKEY_THMB_L, RZKEY_THMB_U, RZKEY_THMB_R, RZKEY_THMB_D
+};
+
+// BMOD_* bit n -> keycode of the modifier
+static const u16 mod_key [BMOD_COUNT] = {
+	KEY_LEFTCTRL, KEY_LEFTSHIFT, KEY_LEFTALT, KEY_LEFTMETA,
+	KEY_RIGHTCTRL, KEY_RIGHTSHIFT, KEY_RIGHTALT, KEY_RIGHTMETA
+};
+
+// Modifier bit of a keycode (0 -> Not a modifier)
+static u8 key_mod (u16 code) {
+	switch (code) {
+	case KEY_LEFTCTRL: return BMOD_LCTRL;
+	case KEY_LEFTSHIFT: return BMOD_LSHIFT;
+	case KEY_LEFTALT: return BMOD_LALT;
+	case KEY_LEFTMETA: return BMOD_LMETA;
+	case KEY_RIGHTCTRL: return BMOD_RCTRL;
+	case KEY_RIGHTSHIFT: return BMOD_RSHIFT;
+	case KEY_RIGHTALT: return BMOD_RALT;
+	case KEY_RIGHTMETA: return BMOD_RMETA;
+	}
+
+	return 0;
+}
+
+// Binds which do the same thing (every field matches)
+static int same_bind (const struct bind* a, const struct bind* b) {
+	return a->type == b->type && a->mods == b->mods && a->data == b->data;
+}
+
+// Press or release a set of modifiers on behalf of one key bind
+// Binds may share a modifier (i.e. Ctrl+C and Ctrl+V held together), so it goes down with the first bind
+// holding it and comes up with the last
+static void hold_mods (struct drvdata* data, u8 mods, int state) {
+	struct kbddata* kdata = data->idata;
+	u8 i;
+
+	for (; mods; mods &= mods - 1) {
+		i = __ffs(mods);
+		if (state ? !kdata->mods[i]++ : !--kdata->mods[i]) report_key(data, mod_key[i], state);
+	}
+}
+
+// Move from one CTRL_KEY bind to another within the current input frame (CTRL_NOP for either -> press or release only)
+// The old key comes up first and the new key goes down last, with the modifiers in between:
+// those both binds hold stay down, so a combo never shows up without its modifiers
+// A bind to a modifier keycode is counted as that modifier (it stays down while a combo also holds it)
+static void swap_bind (struct drvdata* data, const struct bind* from, const struct bind* to) {
+	u8 from_mod = key_mod(from->data);
+	u8 to_mod = key_mod(to->data);
+
+	if (from->data && !from_mod) report_key(data, from->data, 0);
+	hold_mods(data, to->mods | to_mod, 1);
+	hold_mods(data, from->mods | from_mod, 0);
+	if (to->data && !to_mod) report_key(data, to->data, 1);
+}
+
+// Press or release a CTRL_KEY bind (see swap_bind())
+static void report_bind (struct drvdata* data, const struct bind* bind, int state) {
+	const struct bind none = { 0 };
+
+	// Plain keys (most binds) go straight out
+	if (!bind->mods && !key_mod(bind->data)) {
+		if (bind->data) report_key(data, bind->data, state);
+		return;
+	}
+
+	if (state) swap_bind(data, &none, bind);
+	else swap_bind(data, bind, &none);
+}
+
+// Extract key events from the raw event
+// The report is turned into a bitmap of held keys and compared against the previous one a word at a time,
+// so the order of the keys within the report does not matter and the cost is bounded by the size of the report
+// Releases are listed before presses (evlist must hold EVENT_MAX events)
+// Returns the number of elements in the event list
+// NOTE: If implementing double-binds, that would likely be added here
+int process_event_kbd (struct event* evlist, struct keystate* held, u8* raw_event, int raw_event_size) {
+	u64 now [4] = { 0 };
+	u64 diff;
+	u8 key;
+
+	int idx;
+	int pass;
+	int count = 0;
+
+	// Memory safety assertions
+	// TODO: Determine expected size conditions
+	if (!raw_event_size || !raw_event) return 0;
+	if (raw_event_size != KEYLIST_LEN) {
+		printk(KERN_WARNING "HID Tartarus: Keyboard raw event has size 0x%02x (different from 0x%02x!)\n", raw_event_size, KEYLIST_LEN);
+		if (raw_event_size > KEYLIST_LEN) raw_event_size = KEYLIST_LEN;
+	}
+
+	// Convert the modifier key bits into unique key indices
+	// Resulting values have been verified not to conflict with device values
+	// ^^Alt = 0x44 ; Shift = 0x42
+	if (raw_event[0] & MODKEY_SHIFT) now[1] |= 1ULL << ((MODKEY_MASK | MODKEY_SHIFT) - 64);
+	if (raw_event[0] & MODKEY_ALT) now[1] |= 1ULL << ((MODKEY_MASK | MODKEY_ALT) - 64);
+
+	for (idx = 2; idx < raw_event_size; ++idx) {
+		key = raw_event[idx];
+		if (!key) break;		// Unused slots are at the end
+
+		// Too many keys at once (ErrorRollOver): the report says nothing about which keys are held
+		if (key == 0x01) return 0;
+		now[key / 64] |= 1ULL << (key % 64);
+	}
+
+	// Releases first, so a key which changes meaning (i.e. a profile key) never overlaps with a new press
+	for (pass = 0; pass < 2; ++pass)
+		for (idx = 0; idx < 4; ++idx) {
+			diff = (now[idx] ^ held->words[idx]) & (pass ? now[idx] : held->words[idx]);
+			for (; diff; diff &= diff - 1) evlist[count++] = (struct event) {
+				.idx = idx * 64 + __ffs64(diff),
+				.state = pass
+			};
+		}
+
+	memcpy(held->words, now, sizeof(now));
+	return count;
+}
+
+// Resolve keyboard action from a key index
+// Sets driver interface data relevant to the processing of the mapped action
+// NOTE: Does not check for null pointers ; caller must hold state_lock and rcu_read_lock()
+void resolve_event_kbd (struct event* ev, struct drvdata* data) {
+	/*/ -- Profile functionality overview --
+	
+		The keymap in effect is a stack of layers (struct layers)
+		Level 0 is the base profile, changed by CTRL_PROFILE binds (or sysfs)
+		Every held CTRL_SHIFT (hypershift) key adds the layer of its profile on top, and removes it again upon release
+		Layers need not be released in the order they were pressed, nor do they need to be different profiles
+
+		A CTRL_TRANS bind falls through to the layer below, so a layer only defines the keys it changes
+		Each level of the stack is kept flattened (transparency already resolved), so a press reads a single entry
+
+		Only the physical keys of the pad are kept in the hot tables (struct padmap) ; other raw keys resolve to CTRL_NOP
+		For any key press, the bind is taken from the top of the stack and remembered in kdata->pressed
+		For any key release, the remembered bind is used instead, regardless of what changed in the meantime
+		Thus a key always releases what it pressed, even across hypershift layers and profile changes
+		A CTRL_KEY bind carries its modifiers, so a combo goes down and up whole within the frame of its key
+
+		During a profile change, held keys whose bind changes will "swap" (see swap_profile_kbd())
+		A "swap" releases the original key mapping and presses the new key mapping, only if both mappings are CTRL_KEY
+		All other such keys are released (if need be) and their release is ignored
+		Which binds change between two profiles is cached per transition, so keys which keep their bind cost nothing
+		The hypershift layers are dropped as well, so releasing their keys does nothing
+	/*/
+	
+	struct kbddata* kdata = data->idata;
+	struct layers* layers = &kdata->layers;
+	struct bind action;
+	u8 slot = pad_index[ev->idx];
+	u32 bit = 1U << slot;
+
+	if (ev->state) {
+		action = layers->flat[layers->depth].key[slot];
+		kdata->pressed[slot] = action;
+		kdata->active = action.type ? kdata->active | bit : kdata->active & ~bit;
+		kdata->stale = layers->depth ? kdata->stale | bit : kdata->stale & ~bit;
+	} else {
+		action = kdata->pressed[slot];
+		kdata->pressed[slot] = (struct bind) { 0 };
+		kdata->active &= ~bit;
+		kdata->stale &= ~bit;
+	}
+
+	trace_tartarus_bind(data->profile, ev, &action, layers->depth);
+
+	// Process and report the mapped keybind action accordingly
+	switch (action.type) {
+	case CTRL_KEY:
+		report_bind(data, &action, ev->state);
+		break;
+
+	case CTRL_MACRO:
+		// Undefined macros fall back to the macro keycodes (for userspace macro daemons)
+		if (play_macro(data, action.data, ev->state)) report_key(data, action.data + 0x28F, ev->state);
+		break;
+
+	case CTRL_SHIFT:
+		if (ev->state) push_layer_kbd(data, action.data, ev->idx);
+		else pop_layer_kbd(data, ev->idx);
+		break;
+
+	case CTRL_PROFILE:
+		// TODO: Figure out mouse support for this (probably involves linking to the other device data?)
+		if (!ev->state) break;
+
+		// NOTE: This key is held too, so the swap ignores it (unless the new profile binds it the same way)
+		if (action.data > rcu_dereference(kdata->maps)->count) break;		// Profile removed since the upload
+		select_profile_kbd(data, action.data);
+		break;
+
+	case CTRL_DEBUG: break;
+	}
+}
+
+// Validate a profile before it is published
+// Binds which carry a profile number are used as map indices, so they must be in range
+// count -> Number of profiles it is published with
+// Returns 0 if the profile is usable
+int check_profile_kbd (const struct profile* profile, u8 count) {
+	const struct bind* bind;
+	int i;
+
+	for (i = 0; i < KEYMAP_LEN; ++i) {
+		bind = profile->keymap + i;
+		switch (bind->type) {
+		case CTRL_KEY:
+			// Any modifiers, and a key the input device has (0 -> Modifiers only)
+			if (bind->data && !bindable_key(bind->data)) return -1;
+			continue;
+
+		case CTRL_SHIFT:
+			if (!bind->data) return -1;
+			fallthrough;
+		case CTRL_PROFILE:
+			if (bind->data > count) return -1;
+			break;
+
+		case CTRL_MACRO:
+			if (bind->data > 0xFF) return -1;		// Macro indices are a u8
+			break;
+		}
+
+		// Only key binds hold modifiers
+		if (bind->mods) return -1;
+	}
+
+	return 0;
+}
+
+// Keycodes a CTRL_KEY bind may send (registered by the input device)
+// The button ranges (mouse, joystick, gamepad, touch) are left out, so userspace still sees a keyboard
+int bindable_key (u16 code) {
+	if (code >= 1 && code <= KEY_MICMUTE) return 1;
+	if (code < KEY_OK || code > KEY_MAX) return 0;
+
+	return (code & ~0x0F) != BTN_DPAD_UP && (code < BTN_TRIGGER_HAPPY || code > BTN_TRIGGER_HAPPY40);
+}
+
+// Expand a sparse profile into a dense keymap (the base map with the profile's own binds on top)
+// NOTE: profile must be within 1 - maps->count
+void expand_profile_kbd (const struct kbdmaps* maps, u8 profile, struct profile* out) {
+	const struct sparsebind* bind = maps->binds + maps->offset[profile - 1];
+	const struct sparsebind* end = maps->binds + maps->offset[profile];
+
+	memcpy(out, &maps->base, sizeof(struct profile));
+	for (; bind < end; ++bind) out->keymap[bind->key] = bind->bind;
+}
+
+// Expand a sparse profile into the keymap of the physical keys
+// NOTE: profile must be within 1 - maps->count
+void expand_padmap_kbd (const struct kbdmaps* maps, u8 profile, struct padmap* out) {
+	const struct sparsebind* bind = maps->binds + maps->offset[profile - 1];
+	const struct sparsebind* end = maps->binds + maps->offset[profile];
+	int i;
+
+	out->key[0] = (struct bind) { 0 };
+	for (i = 1; i <= PAD_KEYS; ++i) out->key[i] = maps->base.keymap[pad_key[i]];
+	for (; bind < end; ++bind) if (pad_index[bind->key]) out->key[pad_index[bind->key]] = bind->bind;
+}
+
+// Encode the binds of a dense profile which differ from base (NULL -> Empty base map)
+// out -> Sparse binds (sorted by key) ; NULL -> Only count them
+// Returns the number of sparse binds
+int pack_profile_kbd (const struct profile* base, const struct profile* profile, struct sparsebind* out) {
+	const struct bind none = { 0 };
+	const struct bind* old;
+	const struct bind* new;
+	int len = 0;
+	int i;
+
+	for (i = 0; i < KEYMAP_LEN; ++i) {
+		old = base ? base->keymap + i : &none;
+		new = profile->keymap + i;
+		if (same_bind(old, new)) continue;
+
+		if (out) out[len] = (struct sparsebind) { .key = i, .bind = *new };
+		++len;
+	}
+
+	return len;
+}
+
+// Change the base profile (0 -> Disable the device)
+// Drops every hypershift layer and swaps the held keys over to the new profile
+// NOTE: Caller must hold state_lock and rcu_read_lock()
+void select_profile_kbd (struct drvdata* data, u8 profile) {
+	struct kbddata* kdata = data->idata;
+	struct layers* layers = &kdata->layers;
+	u8 prev = layers->profile[0];
+	struct swapdiff* entry = kdata->swaps + ((prev * 31 + profile) & (SWAP_CACHE - 1));
+	struct padmap from;
+	int hit = entry->from == prev && entry->to == profile;
+	int i;
+
+	// Keep the old base keymap around to find the differences
+	if (!hit) from = layers->flat[0];
+	else ++kdata->swapstats.hits;
+
+	layers->depth = 0;
+	layers->profile[0] = profile;
+	flatten_layers_kbd(data, 0);
+
+	if (!hit) {
+		entry->from = prev;
+		entry->to = profile;
+		entry->diff = 0;
+		for (i = 1; i <= PAD_KEYS; ++i)
+			if (!same_bind(from.key + i, layers->flat[0].key + i)) entry->diff |= 1U << i;
+	}
+
+	// Keys pressed with the base profile keep their bind unless it differs
+	swap_profile_kbd(data, layers->flat, entry->diff | kdata->stale);
+	set_profile(data, profile);
+}
+
+// Add a hypershift layer, held by key
+// NOTE: Caller must hold state_lock and rcu_read_lock()
+void push_layer_kbd (struct drvdata* data, u8 profile, u8 key) {
+	struct kbddata* kdata = data->idata;
+	struct layers* layers = &kdata->layers;
+
+	// The release of this key will find no layer to remove
+	if (layers->depth >= LAYER_DEPTH || profile > rcu_dereference(kdata->maps)->count) return;
+
+	++layers->depth;
+	layers->profile[layers->depth] = profile;
+	layers->key[layers->depth] = key;
+	flatten_layers_kbd(data, layers->depth);
+
+	trace_tartarus_hypershift(1, profile, layers->depth);
+	set_profile(data, profile);
+}
+
+// Remove the hypershift layer held by key (wherever it is in the stack)
+// NOTE: Caller must hold state_lock and rcu_read_lock()
+void pop_layer_kbd (struct drvdata* data, u8 key) {
+	struct kbddata* kdata = data->idata;
+	struct layers* layers = &kdata->layers;
+	u8 level;
+	u8 i;
+
+	for (level = layers->depth; level > 0 && layers->key[level] != key; --level);
+	if (!level) return;		// Dropped by a profile change
+
+	trace_tartarus_hypershift(0, layers->profile[level], layers->depth - 1);
+
+	// Layers above the removed one move down and fall through to a different level now
+	for (i = level; i < layers->depth; ++i) {
+		layers->profile[i] = layers->profile[i + 1];
+		layers->key[i] = layers->key[i + 1];
+	}
+
+	--layers->depth;
+	flatten_layers_kbd(data, level);
+	set_profile(data, layers->profile[layers->depth]);
+}
+
+// Rebuild the effective keymap of every level from 'level' up
+// Also needed whenever the profiles themselves change
+// NOTE: Caller must hold state_lock and rcu_read_lock()
+void flatten_layers_kbd (struct drvdata* data, u8 level) {
+	struct kbddata* kdata = data->idata;
+	struct layers* layers = &kdata->layers;
+	const struct kbdmaps* maps = rcu_dereference(kdata->maps);
+	struct bind* dst;
+	u8 profile;
+	int i;
+
+	for (; level <= layers->depth; ++level) {
+		dst = layers->flat[level].key;
+		profile = layers->profile[level];
+
+		// Profiles dropped by a smaller upload behave as if disabled
+		if (!profile || profile > maps->count) {
+			memset(dst, 0, sizeof(struct padmap));
+			continue;
+		}
+
+		expand_padmap_kbd(maps, profile, layers->flat + level);
+		for (i = 1; i <= PAD_KEYS; ++i) {
+			if (dst[i].type != CTRL_TRANS) continue;
+			dst[i] = level ? layers->flat[level - 1].key[i] : (struct bind) { 0 };
+		}
+	}
+}
+
+// Swap keypresses across profiles
+// map -> Keymap to swap the held keys to ; NULL -> release keys only
+// changed -> Slots which may need a swap (bit n -> slot n) ; other held keys keep their bind
+// NOTE: Caller must hold state_lock and rcu_read_lock()
+// TODO: Because of multiple actions in one event, it is currently possible to have a rare double-press when the 
+//       "pressed but not processed" key is released, pressed in the new profile, and then pressed in the new profile for real
+void swap_profile_kbd (struct drvdata* data, const struct padmap* map, u32 changed) {
+	struct kbddata* kdata = data->idata;
+	struct swapstats* stats = &kdata->swapstats;
+	struct bind* action_release;
+	struct bind action_press;
+	
+	u32 keys = kdata->active & changed;
+	u8 slot;
+	u8 swapped = 0;
+	u8 ignored = 0;
+	u64 start = latency_start();
+
+	++stats->swaps;
+	stats->skipped += hweight32(kdata->active & ~changed);
+
+	for (; keys; keys &= keys - 1) {
+		slot = __ffs(keys);
+		action_release = kdata->pressed + slot;
+		action_press = map ? map->key[slot] : (struct bind) { 0 };
+
+		switch (action_release->type) {
+		case CTRL_NOP:
+			continue;		// Already ignored
+
+		case CTRL_KEY:
+			if (same_bind(action_release, &action_press)) {
+				++stats->skipped;
+				continue;
+			}
+
+			// Send up of old and down of new (key -> key only), combos whole and in the same frame
+			++swapped;
+			if (action_press.type == CTRL_KEY) {
+				swap_bind(data, action_release, &action_press);
+				*action_release = action_press;
+				continue;
+			}
+
+			report_bind(data, action_release, 0);
+			break;
+
+		case CTRL_MACRO:
+			// Deliver the release (ends a loop-while-held macro)
+			if (play_macro(data, action_release->data, 0)) report_key(data, action_release->data + 0x28F, 0);
+			break;
+		}
+
+		// Ignore the release
+		*action_release = (struct bind) { 0 };
+		kdata->active &= ~(1U << slot);
+		++ignored;
+	}
+
+	// Every key looked at now holds its bind from map (or nothing)
+	kdata->stale &= ~changed;
+	stats->rewritten += swapped;
+	stats->ignored += ignored;
+
+	trace_tartarus_swap(data->profile, map ? kdata->layers.profile[0] : 0, swapped, ignored);
+	latency_record(data, LAT_SWAP, start);
+}
+
+// Release every held key as though the pad had reported them all up (i.e. before the device suspends)
+// Layers unwind and bound keys release exactly as they would by hand, so nothing is left stuck or released twice
+// Returns the number of keys released
+// NOTE: Caller must hold state_lock and rcu_read_lock()
+int release_keys_kbd (struct drvdata* data) {
+	struct kbddata* kdata = data->idata;
+	struct event evlist[EVENT_MAX];
+	u8 none[KEYLIST_LEN] = { 0 };
+	int len;
+	int i;
+
+	len = process_event_kbd(evlist, &kdata->held, none, KEYLIST_LEN);
+	for (i = 0; i < len; ++i) resolve_event_kbd(evlist + i, data);
+
+	return len;
+}
+
+// Forget the cached profile transitions (the profiles changed)
+// Held keys were pressed with the old profiles, so they must all be looked at by the next swap
+// NOTE: Caller must hold state_lock
+void flush_swaps_kbd (struct drvdata* data) {
+	struct kbddata* kdata = data->idata;
+
+	memset(kdata->swaps, 0, sizeof(kdata->swaps));
+	kdata->stale = kdata->active;
+}
+
+// Validate macros before they are published
+// Every macro must stay within its own bytes, use known opcodes, balance its loops, and end with MOP_END
+// Returns 0 if the macros are playable
+int check_macros (const struct macros* macros) {
+	const u8* code;
+	u16 pc;
+	u16 end;
+	u8 depth;
+	int i;
+
+	if (macros->len > MACRO_CODE_LEN) return -1;
+
+	for (i = 0; i < MACRO_COUNT; ++i) {
+		if (!macros->size[i]) continue;
+
+		// (Summed as int, so a huge offset or size cannot wrap around the bounds check)
+		if (macros->offset[i] + macros->size[i] > macros->len) return -1;
+
+		pc = macros->offset[i];
+		end = pc + macros->size[i];
+		if (macros->code[end - 1] != MOP_END) return -1;
+
+		code = macros->code;
+		depth = 0;
+		while (pc < end - 1) {
+			switch (code[pc]) {
+			case MOP_DOWN:
+			case MOP_UP:
+				if (pc + 2 >= end || !code[pc + 1] || code[pc + 1] > MOP_KEY_MAX) return -1;
+				pc += 2;
+				break;
+
+			case MOP_DELAY:
+				if (pc + 3 >= end) return -1;
+				pc += 3;
+				break;
+
+			case MOP_LOOP:
+				if (pc + 2 >= end || ++depth > MACRO_DEPTH) return -1;
+				pc += 2;
+				break;
+
+			case MOP_NEXT:
+				if (!depth--) return -1;
+				pc += 1;
+				break;
+
+			default:		// Includes an early MOP_END
+				return -1;
+			}
+		}
+
+		if (pc != end - 1 || depth) return -1;
+	}
+
+	return 0;
+}
+
+// Begin playing a macro (replaces whatever was playing)
+// NOTE: Caller must hold state_lock and rcu_read_lock() and check that the macro is defined
+void start_macro (struct drvdata* data, u8 macro) {
+	struct kbddata* kdata = data->idata;
+	struct macroplay* play = &kdata->play;
+
+	stop_macro(data);
+
+	play->active = 1;
+	play->macro = macro;
+	play->held = 1;
+	play->depth = 0;
+	play->pc = rcu_dereference(kdata->macros)->offset[macro];
+}
+
+// Run the playing macro up to its next delay
+// Returns the delay (ms) before the next call, or -1 once the macro is done
+// NOTE: Caller must hold state_lock and rcu_read_lock()
+int run_macro (struct drvdata* data) {
+	struct kbddata* kdata = data->idata;
+	struct macroplay* play = &kdata->play;
+	struct macros* macros = rcu_dereference(kdata->macros);
+	const u8* op;
+	u8 key;
+	int top;
+	int steps;
+
+	if (!play->active || !macros) return -1;
+
+	for (steps = 0; steps < MACRO_STEPS; ++steps) {
+		op = macros->code + play->pc;
+
+		switch (op[0]) {
+		case MOP_DOWN:
+		case MOP_UP:
+			key = op[1];
+			report_key(data, key, op[0] == MOP_DOWN);
+
+			if (op[0] == MOP_DOWN) play->down.bytes[key / 8] |= 1 << (key % 8);
+			else play->down.bytes[key / 8] &= ~(1 << (key % 8));
+
+			play->pc += 2;
+			break;
+
+		case MOP_DELAY:
+			play->pc += 3;
+			return op[1] | op[2] << 8;
+
+		case MOP_LOOP:
+			play->loop[play->depth].pc = play->pc + 2;
+			play->loop[play->depth].count = op[1];
+			++play->depth;
+			play->pc += 2;
+			break;
+
+		case MOP_NEXT:
+			// Counted loops run 'count' times ; held loops run until the macro key is released
+			top = play->depth - 1;
+			if (play->loop[top].count ? --play->loop[top].count : play->held) {
+				play->pc = play->loop[top].pc;
+				break;
+			}
+
+			--play->depth;
+			play->pc += 1;
+			break;
+
+		default:
+			stop_macro(data);
+			return -1;
+		}
+	}
+
+	// Out of budget (a loop without any delay) ; let everything else run for a moment
+	return 1;
+}
+
+// Stop the playing macro and release every key it still holds
+// NOTE: Caller must hold state_lock
+void stop_macro (struct drvdata* data) {
+	struct kbddata* kdata = data->idata;
+	struct macroplay* play = &kdata->play;
+	int i;
+
+	for (i = 0; i < KEYMAP_LEN; ++i)
+		if (play->down.bytes[i / 8] & 1 << (i % 8)) report_key(data, i, 0);
+
+	play->down = (struct keystate) { 0 };
+	play->active = 0;
+}
+
+// Extract key events from the raw event
+// Returns the number of elements in the keylist array
+int process_event_mouse (struct event* evlist, u8* raw_event, int raw_event_size) {
+	int evcount = 0;
+	u8 mwheel;
+	
+	// log_event(raw_event, raw_event_size, MOUSE_INUM);
+
+	// Memory safety assertions
+	// All events should have a length of 8 bytes
+	if (!raw_event || raw_event_size < 4) return 0;
+
+	// Check the wheel button state (report this every time)
+	// https://elixir.bootlin.com/linux/v6.7.5/source/drivers/hid/usbhid/usbmouse.c#L68
+	evlist[evcount++] = (struct event) {
+		.idx = MWHEEL_BTN,
+		.state = raw_event[0] & MWHEEL_BTN
+	};
+
+	// Check the wheel state
+	// NOTE: We could raw dog this one too, but we'll need this format for fancier functionality later
+	if ((mwheel = raw_event[3])) evlist[evcount++] = (struct event) {
+		.idx = MWHEEL_WHEEL,
+		.state = mwheel
+	};
+	
+	return evcount;
+}
+
+// Report mouse events to the kernel
+void resolve_event_mouse (struct event* event, struct drvdata* data) {
+	u8 state;
+	
+	switch (event->idx) {
+	case MWHEEL_BTN:
+		report_key(data, BTN_MIDDLE, event->state);
+		break;
+	case MWHEEL_WHEEL:
+		state = event->state + 1;
+		report_rel(data, REL_WHEEL, (int) state - 1);
+		break;
+	}
+}
@@ -0,0 +1,384 @@
+#ifndef _TARTARUS_TRANSLATE
+#define _TARTARUS_TRANSLATE
+
+// Input translation core
+// Shared by the kernel module and userspace builds (i.e. benchmarks), so this header must not require kernel headers
+// Only the small compatibility shim below differs between the two
+
+#ifdef __KERNEL__
+#include <linux/bitops.h>
+#include <linux/input.h>
+#include <linux/kernel.h>
+#include <linux/mutex.h>
+#include <linux/rcupdate.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+#include <linux/timekeeping.h>
+#include <linux/types.h>
+#include <linux/workqueue.h>
+
+#else
+#include <linux/input-event-codes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+
+struct mutex { int unused; };
+typedef struct { int unused; } spinlock_t;
+struct rcu_head { void* next; void (*func) (struct rcu_head*); };
+struct work_struct { int unused; };
+
+#define __rcu
+#define __percpu
+#define rcu_dereference(p)	(p)
+#define __ffs(x)			__builtin_ctzl(x)
+#define __ffs64(x)			__builtin_ctzll(x)
+#define hweight32(x)		__builtin_popcount(x)
+#define READ_ONCE(x)		(x)
+#define fallthrough			__attribute__((__fallthrough__))
+#define KERN_WARNING		""
+#define printk(...)			fprintf(stderr, __VA_ARGS__)
+#endif
+
+
+// PROPERTIES
+#define PROFILE_COUNT	8			// Number of profiles a keyboard starts with (resized by uploads, see struct kbdmaps)
+#define PROFILE_MAX		255			// Most profiles a keyboard can hold (profile numbers are a u8)
+#define KEYLIST_LEN		8			// Maximum number device-supported simultaneous keypresses (6 normal keys + shift and alt)
+#define EVENT_MAX		16			// Most key events a single report can produce (every key released and as many pressed)
+#define KEYMAP_LEN		0x100		// Number of entries in a complete keymap
+#define LAYER_DEPTH		4			// Maximum number of hypershift layers held at once
+#define SWAP_CACHE		16			// Profile transitions remembered by select_profile_kbd() (power of 2)
+#define MACRO_COUNT		32			// Number of macros stored in the driver (indexed by CTRL_MACRO bind data)
+#define MACRO_CODE_LEN	0xF00		// Bytecode shared by all macros (the upload fits in one page)
+#define MACRO_DEPTH		4			// Maximum nesting of macro loops
+#define MACRO_STEPS		64			// Instructions run per sequencer tick before yielding (loops without a delay)
+
+// LATENCY STAGES (histograms in debugfs)
+#define LAT_REPORT		0			// .raw_event entry -> last input reported
+#define LAT_DECODE		1			// Raw report -> key events
+#define LAT_RESOLVE		2			// Key events -> input (includes any profile swap)
+#define LAT_SWAP		3			// swap_profile_kbd()
+#define LAT_CMD			4			// Device command queued -> completed (see struct cmdqueue)
+#define LAT_RESUME		5			// Device resumed -> first key event
+#define LAT_STAGES		6
+
+
+// KEYS
+#define RZKEY_01		0x1E		// Funny names because we'd conflict with existing defines in linux kernel
+#define RZKEY_02		0x1F
+#define RZKEY_03		0x20
+#define RZKEY_04		0x21
+#define RZKEY_05		0X22
+#define RZKEY_06		0x2B
+#define RZKEY_07		0x14
+#define RZKEY_08		0x1A
+#define RZKEY_09		0x08
+#define RZKEY_10		0x15
+#define RZKEY_11		0x39
+#define RZKEY_12		0x04
+#define RZKEY_13		0x16
+#define RZKEY_14		0x07
+#define RZKEY_15		0x09
+#define RZKEY_16		0x42		// (Actual 0x02 -> Shift)
+#define RZKEY_17		0x1D
+#define RZKEY_18		0x1B
+#define RZKEY_19		0x06
+#define RZKEY_20		0x2C
+#define RZKEY_CIRCLE	0x44		// (Actual 0x04 -> Alt)
+#define RZKEY_THMB_L	0x50
+#define RZKEY_THMB_U	0x52
+#define RZKEY_THMB_R	0x4F
+#define RZKEY_THMB_D	0x51
+#define PAD_KEYS		25			// Physical keys of the pad (the RZKEY_* above)
+
+#define MODKEY_SHIFT	0x02		// Bit pattern for the shift key (key 16)
+#define MODKEY_ALT		0x04		// Bit pattern for the alt key (circular thumb button)
+#define MODKEY_MASK		0x40		// Applied to all modkey keycodes (i.e. 0000 0010 (lshift) -> 0100 0010)
+#define MWHEEL_BTN		0x04		// Bit pattern for the mouse wheel button
+#define MWHEEL_WHEEL	0x08
+
+// BINDS
+#define CTRL_NOP		0x00		// No key action
+#define CTRL_KEY     	0x01		// Keyboard button
+#define CTRL_SHIFT      0x02		// Hypershift layer	(stack profile while held)
+#define CTRL_PROFILE   	0x03		// Change profile	(swap profile upon press)
+#define CTRL_MACRO		0x04		// TODO: Play macro action 		(playback list of key actions)
+#define CTRL_SCRIPT		0x05		// TODO: Execute script relative to the current user's home dir
+#define CTRL_SWKEY		0x06		// TODO: Key that will be "swapped" upon hypershift state change
+#define CTRL_MMOV		0x07		// TODO: Move the mouse
+#define CTRL_MWHEEL		0x08		// TODO: Mouse wheel action
+#define CTRL_TRANS		0x09		// Transparent (use the bind of the layer below)
+#define CTRL_DEBUG		0xFF		// (DEBUG)
+
+// BIND MODIFIERS (held along with the key of a CTRL_KEY bind ; same order as the modifier byte of a HID keyboard)
+#define BMOD_LCTRL		0x01
+#define BMOD_LSHIFT		0x02
+#define BMOD_LALT		0x04
+#define BMOD_LMETA		0x08
+#define BMOD_RCTRL		0x10
+#define BMOD_RSHIFT		0x20
+#define BMOD_RALT		0x40
+#define BMOD_RMETA		0x80
+#define BMOD_COUNT		8
+
+// MACRO OPCODES (arguments follow the opcode byte)
+#define MOP_END			0x00		// End of macro (releases any keys the macro still holds)
+#define MOP_DOWN		0x01		// Key press		<u8 keycode>
+#define MOP_UP			0x02		// Key release		<u8 keycode>
+#define MOP_DELAY		0x03		// Wait			<u16 milliseconds (little endian)>
+#define MOP_LOOP		0x04		// Loop start		<u8 count> ; 0 -> loop while the macro key is held
+#define MOP_NEXT		0x05		// Loop end (jumps back to the matching MOP_LOOP)
+#define MOP_KEY_MAX		248			// Highest keycode a macro may send (see input_config)
+
+
+// STRUCTS
+struct cmdqueue;
+struct ctrl_backend;
+struct dentry;
+struct device;
+struct input_dev;
+struct jitter;
+struct latency;
+struct ledctl;
+struct macroctl;
+struct statepage;
+struct usb_device;
+
+// Defines the behavior of a key
+// A CTRL_KEY bind presses its modifiers and key as one combo (i.e. Ctrl+Shift+T) ; data 0 -> Modifiers only
+struct bind {
+	u8 type;		// Event type
+	u8 mods;		// Modifiers held along with the key (BMOD_* ; CTRL_KEY only)
+	u16 data;		// Respective data (key code, profile number, or index of macro)
+};
+
+// Single event and its respective state
+struct event {
+	u8 idx;			// "Key" index
+	u8 state;		// 0: Release ; 1: Press
+};
+
+// Bitmap container for interface key states
+struct keystate {
+	union {
+		u8 bytes [32];
+		u32 data [8];
+		u64 words [4];
+	};
+};
+// Device driver data (for passing data across functions; unique per interface)
+struct drvdata {
+	u8 profile;					// Active profile number (keyboard and mouse have one each)
+	u8 inum;					// Interface number : 0 -> KB, 1 -> RGB???, 2 -> Mouse (wheel)
+	void* idata;				// Interface data (keyboard, mouse, etc.)
+	struct usb_device* parent;	// Parent device ref (for sending URBs) ; NULL if not a USB transport
+	const struct ctrl_backend* ctrl;	// Device command channel
+	struct cmdqueue* cmdq;		// Device command queue (keyboard only ; NULL otherwise)
+	struct ledctl* leds;		// Profile LED pipeline (keyboard only ; NULL otherwise)
+	struct macroctl* macro;		// Macro sequencer timer (keyboard only ; NULL otherwise)
+	struct statepage* state;	// Shared state page (keyboard only ; NULL otherwise)
+
+	struct device* dev;			// HID device (for sysfs notifications)
+	unsigned long notify;		// Pending sysfs notifications (NOTIFY_* bits)
+	struct work_struct notify_work;	// Raises them outside of the report path
+	struct input_dev* input;	// Input device ref (for sending inputs to kernel)
+	struct mutex lock;			// Serializes keymap writers (sysfs) ; never taken by the report path
+	spinlock_t state_lock;		// Guards the device state (profile, held keys, layers) against the report path
+
+	struct latency __percpu* lat;	// Per-stage latency histograms (separate allocation, off the hot cache lines)
+	struct jitter* jitter;		// Report arrival times against the polling interval
+	u64 resume_ns;				// latency_start() of the last resume until the first key event ; 0 -> None pending
+	u8 autosuspended;			// The last suspend was a runtime one (idle pad, woken by a keypress)
+	u8 autosuspend;				// Runtime autosuspend was enabled by this driver (undone upon removal)
+	u8 delay_set;				// The autosuspend delay was set by this driver (prev_delay comes back upon removal)
+	int prev_delay;				// Autosuspend delay (ms) of the pad before autosuspend_delay overrode it
+	struct dentry* debug_dir;	// debugfs directory of this interface
+};
+
+// Device profiles numbers range 1-count, corresponding to indexes 0-(count-1) ; 0 -> Device disabled
+struct profile {
+	struct bind keymap [KEYMAP_LEN];
+};
+
+// One bind of a sparse profile
+struct sparsebind {
+	u8 key;								// Raw key index
+	struct bind bind;
+};
+
+// Complete set of keyboard profiles
+// Profiles share one base map and only store the binds where they differ from it (sorted by key),
+// so memory grows with the binds actually defined ; active profiles are expanded into dense tables (struct layers)
+// Published via RCU: once visible to the report path a table is never modified
+// Writers build a new table (copying the base and untouched profiles) and swap the pointer
+struct kbdmaps {
+	struct rcu_head rcu;
+	u8 count;							// Number of profiles (1 - PROFILE_MAX)
+	u8 base_profile;					// Profile the base map was taken from (0 -> None)
+	u16 len;							// Sparse binds of all profiles
+	struct sparsebind* binds;			// Profile n holds binds[offset[n - 1]] up to binds[offset[n]]
+	struct profile base;				// Binds shared by every profile
+	u16 offset [];						// count + 1 entries (the binds follow them in the same allocation)
+};
+
+// Compiled macros (see MOP_*)
+// Published via RCU like struct kbdmaps ; macro n occupies code[offset[n]] to code[offset[n] + size[n]]
+struct macros {
+	struct rcu_head rcu;
+	u16 len;							// Bytes of code in use
+	u16 offset [MACRO_COUNT];
+	u16 size [MACRO_COUNT];				// 0 -> Macro not defined
+	u8 code [MACRO_CODE_LEN];
+};
+
+// Macro sequencer state (one macro plays at a time per device)
+struct macroplay {
+	u8 active;							// A macro is playing
+	u8 macro;							// Index of the playing macro
+	u8 held;							// Key which started the macro is still held
+	u8 depth;							// Loop nesting
+	u16 pc;								// Offset of the next instruction (into struct macros code)
+	struct {
+		u16 pc;							// First instruction of the loop body
+		u8 count;						// Iterations remaining ; 0 -> Loop while held
+	} loop [MACRO_DEPTH];
+	u64 due;							// Time of the next step (ns, monotonic)
+	struct keystate down;				// Keys the macro currently holds
+};
+
+// Keymap of the physical keys only (indexed by pad_index[] of the raw key)
+// Slot 0 stands for every raw key which is not on the pad and always holds CTRL_NOP
+// ~100 bytes instead of the 1024 of struct profile, so the hot state of a device spans a few cache lines
+struct padmap {
+	struct bind key [PAD_KEYS + 1];
+};
+
+// Hypershift layer stack
+// Level 0 is the base profile and each held CTRL_SHIFT key adds a layer on top
+// CTRL_TRANS binds fall through to the level below, so every level keeps its effective keymap
+// flattened whenever the stack or the profiles change: a lookup is a single load at the top level
+struct layers {
+	u8 depth;							// Layers held on top of the base profile
+	u8 profile [LAYER_DEPTH + 1];		// Profile number of each level ([0] -> Base profile ; 0 -> Disabled)
+	u8 key [LAYER_DEPTH + 1];			// Raw key holding each layer ([0] unused)
+	struct padmap flat [LAYER_DEPTH + 1];	// Effective keymap of each level
+};
+
+// Keymap differences of one profile transition
+// Entries are cleared upon upload ; a cleared entry is the (valid) 0 -> 0 transition
+struct swapdiff {
+	u8 from;
+	u8 to;
+	u32 diff;							// Slots whose base bind differs (bit n -> slot n of struct padmap)
+};
+
+// Profile swap statistics (debugfs 'swaps')
+struct swapstats {
+	u32 swaps;							// Profile changes (and releases of every key)
+	u32 hits;							// Profile changes whose transition was cached
+	u32 rewritten;						// Held keys moved over to their new bind
+	u32 ignored;						// Held keys released early (their release is ignored)
+	u32 skipped;						// Held keys left alone since their bind does not change
+};
+
+// Driver data for keyboard interface
+struct kbddata {
+	struct keystate held;				// Device button state (raw key indices ; modifiers at MODKEY_MASK | bit)
+	struct bind pressed [PAD_KEYS + 1];	// Bind each held key was pressed with (its release uses the same) ; CTRL_NOP -> Ignored
+	u8 mods [BMOD_COUNT];				// Key binds holding each modifier (BMOD_* bit n -> mods[n]) ; down while nonzero
+	u32 active;							// Slots with a bind in pressed (bit n -> slot n)
+	u32 stale;							// Active slots whose bind may differ from the base profile (pressed with a layer or before an upload)
+	struct layers layers;				// Base profile and hypershift layers
+	struct swapdiff swaps [SWAP_CACHE];	// Recent profile transitions (see select_profile_kbd())
+	struct swapstats swapstats;
+	
+	struct kbdmaps __rcu* maps;			// Device profiles (read under rcu_read_lock())
+	struct macros __rcu* macros;		// Uploaded macros (read under rcu_read_lock()) ; NULL -> None
+	struct macroplay play;				// Macro sequencer (guarded by state_lock)
+
+	u8* config_buf;						// Staging buffer for a config upload in progress (guarded by drvdata lock)
+	size_t config_len;					// Bytes received so far
+};
+
+struct mousedata {
+	// u8 mwheel_state;					// Value directly from raw event (not clamped)
+	struct mprofile {
+		struct bind keymap [8];
+	} maps [PROFILE_COUNT];
+};
+
+// TODO: Wild idea for a "mouse" bind
+// 		 Middle click on the scroll wheel goes to "profile mode"
+//		 Rolling the wheel up or down (in this mode) will "roll" through the profiles
+//		 EX: I might have a couple different profiles for convenient binds for portal 2 speedruns
+
+// INPUT PROCESSING (translate.c)
+int process_event_kbd (struct event*, struct keystate*, u8*, int);
+void resolve_event_kbd (struct event*, struct drvdata*);
+int check_profile_kbd (const struct profile*, u8);
+int bindable_key (u16);
+void expand_profile_kbd (const struct kbdmaps*, u8, struct profile*);
+void expand_padmap_kbd (const struct kbdmaps*, u8, struct padmap*);
+int pack_profile_kbd (const struct profile*, const struct profile*, struct sparsebind*);
+void select_profile_kbd (struct drvdata*, u8);
+void push_layer_kbd (struct drvdata*, u8, u8);
+void pop_layer_kbd (struct drvdata*, u8);
+void flatten_layers_kbd (struct drvdata*, u8);
+void swap_profile_kbd (struct drvdata*, const struct padmap*, u32);
+void flush_swaps_kbd (struct drvdata*);
+int release_keys_kbd (struct drvdata*);
+int check_macros (const struct macros*);
+void start_macro (struct drvdata*, u8);
+int run_macro (struct drvdata*);
+void stop_macro (struct drvdata*);
+int process_event_mouse (struct event*, u8*, int);
+void resolve_event_mouse (struct event*, struct drvdata*);
+// void swap_profile_mouse ( ... );
+
+// void swap_profile_kbd_old (struct device*, struct drvdata*, u8);
+
+// OUTPUT (provided by the embedding)
+// set_profile() lives with the device commands (driver.c) since it also updates the profile LEDs
+void set_profile (struct drvdata*, u8);
+
+// play_macro() schedules the sequencer (driver.c) ; returns nonzero if the macro is not defined
+int play_macro (struct drvdata*, u8, u8);
+
+#ifdef __KERNEL__
+// Latency probes (recorded by driver.c)
+static inline u64 latency_start (void) {
+	return ktime_get_ns();
+}
+
+void latency_record (struct drvdata*, u8, u64);
+
+static inline void report_key (struct drvdata* data, unsigned int code, int state) {
+	input_report_key(data->input, code, state);
+}
+
+static inline void report_rel (struct drvdata* data, unsigned int code, int value) {
+	input_report_rel(data->input, code, value);
+}
+
+#else
+// Userspace builds supply their own sink
+void report_key (struct drvdata*, unsigned int, int);
+void report_rel (struct drvdata*, unsigned int, int);
+
+// Latency probes are kernel-only
+static inline u64 latency_start (void) { return 0; }
+static inline void latency_record (struct drvdata* data, u8 stage, u64 start) { }
+
+// Tracepoints (trace.h) are kernel-only
+#define trace_tartarus_bind(...)		do { } while (0)
+#define trace_tartarus_hypershift(...)	do { } while (0)
+#define trace_tartarus_swap(...)		do { } while (0)
+#endif
+
+#endif